@@ -19,6 +19,7 @@ pub struct C_LockedView {
     len: usize,
     mtx: *mut std::ffi::c_void,
     slot: *mut std::ffi::c_void,
+    owner: u64,
 }
 
 type ForEachNewSlotCallback = extern "C" fn(C_LockedView, *mut std::ffi::c_void) -> ();
@@ -38,6 +39,8 @@ extern "C" {
 
     pub fn babus_locked_view_data(clv: *const C_LockedView) -> *const std::ffi::c_void;
     pub fn babus_locked_view_length(clv: *const C_LockedView) -> usize;
+    pub fn babus_locked_view_publish_nanos(clv: *const C_LockedView) -> i64;
+    pub fn babus_locked_view_publisher_pid(clv: *const C_LockedView) -> i32;
     pub fn babus_unlock_view(clv: *mut C_LockedView);
 
     pub fn babus_waiter_alloc(cd: *mut ClientDomain) -> *mut Waiter;
@@ -45,6 +48,8 @@ extern "C" {
     pub fn babus_waiter_subscribe_to(w: *mut Waiter, cs: *mut ClientSlot, wakeWith: bool);
     pub fn babus_waiter_unsubscribe_from(w: *mut Waiter, cs: *mut ClientSlot);
     pub fn babus_waiter_wait_exclusive(w: *mut Waiter);
+    pub fn babus_waiter_poll_fd(w: *mut Waiter) -> i32;
+    pub fn babus_waiter_drain_poll_fd(w: *mut Waiter);
 
     pub fn babus_waiter_for_each_new_slot(w: *mut Waiter, userData: *mut std::ffi::c_void, cb: ForEachNewSlotCallback);
 
@@ -0,0 +1,166 @@
+#include "babus/client.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace babus;
+
+//
+// Control and dump a domain's event trace (see `babus/trace.h`).
+//
+//      babusTrace <domain> enable|disable|clear
+//      babusTrace <domain> dump [out.json]
+//
+// `dump` writes Chrome trace JSON (open it in chrome://tracing or ui.perfetto.dev). The ring keeps
+// recording while it is dumped; records overwritten during the dump are skipped.
+//
+
+namespace {
+
+    struct TickClock {
+        // Pair of (ticks, CLOCK_MONOTONIC ns) sampled together, and the measured tick rate.
+        uint64_t ticks0;
+        int64_t nanos0;
+        double ticksPerNano;
+
+        static TickClock calibrate() {
+            TickClock c;
+            uint64_t t0 = traceTicks();
+            int64_t n0  = monotonicNanos();
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            c.ticks0       = traceTicks();
+            c.nanos0       = monotonicNanos();
+            c.ticksPerNano = double(c.ticks0 - t0) / double(c.nanos0 - n0);
+            return c;
+        }
+
+        inline double toMicros(uint64_t ticks) const {
+            return (double(nanos0) - double(int64_t(ticks0 - ticks)) / ticksPerNano) / 1000.;
+        }
+        inline double durationMicros(uint64_t ticks) const {
+            return double(ticks) / ticksPerNano / 1000.;
+        }
+    };
+
+    struct CopiedRecord {
+        uint64_t ticks;
+        uint32_t arg;
+        int32_t pid;
+        int32_t tid;
+        uint32_t seq;
+        uint8_t slot;
+        TraceEvent event;
+    };
+
+    std::vector<CopiedRecord> copyRing(TraceRing& ring) {
+        std::vector<CopiedRecord> out;
+        uint64_t head  = ring.head.load();
+        uint64_t begin = head > TraceRing::Capacity ? head - TraceRing::Capacity : 0;
+        out.reserve(head - begin);
+
+        for (uint64_t i = begin; i < head; i++) {
+            TraceRecord& r = ring.records[i % TraceRing::Capacity];
+            if (r.stamp.load(std::memory_order_acquire) != uint32_t(i + 1)) continue;
+            CopiedRecord c { r.ticks, r.arg, r.pid, r.tid, r.seq, r.slot, r.event };
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (r.stamp.load(std::memory_order_relaxed) != uint32_t(i + 1)) continue; // Overwritten while copying.
+            out.push_back(c);
+        }
+        return out;
+    }
+
+    std::string slotName(Domain* dom, uint8_t slot) {
+        if (slot == TraceNoSlot or slot >= dom->numSlots or dom->slotNames[slot][0] == 0) return "?";
+        return std::string(dom->slotNames[slot], strnlen(dom->slotNames[slot], MaxNameLength));
+    }
+
+    int dump(Domain* dom, FILE* f) {
+        TickClock clock                   = TickClock::calibrate();
+        std::vector<CopiedRecord> records = copyRing(dom->trace());
+        if (records.empty()) {
+            SPDLOG_WARN("trace ring is empty (is tracing enabled?)");
+        }
+
+        fmt::print(f, "{{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+        bool first = true;
+        for (const auto& r : records) {
+            double ts        = clock.toMicros(r.ticks);
+            std::string slot = slotName(dom, r.slot);
+            fmt::print(f, "{}", first ? "" : ",\n");
+            first = false;
+
+            switch (r.event) {
+                case TraceEvent::WriteLock: {
+                    double dur = clock.durationMicros(r.arg);
+                    fmt::print(f, R"({{"name":"lock {}","ph":"X","ts":{:.3f},"dur":{:.3f},"pid":{},"tid":{},"args":{{"seq":{}}}}})", slot,
+                               ts - dur, dur, r.pid, r.tid, r.seq);
+                    break;
+                }
+                case TraceEvent::Publish:
+                    fmt::print(f, R"({{"name":"publish {}","ph":"i","s":"t","ts":{:.3f},"pid":{},"tid":{},"args":{{"seq":{},"len":{}}}}})",
+                               slot, ts, r.pid, r.tid, r.seq, r.arg);
+                    break;
+                case TraceEvent::Wake:
+                    fmt::print(f, R"({{"name":"wake","ph":"i","s":"t","ts":{:.3f},"pid":{},"tid":{},"args":{{"mask":"0x{:x}"}}}})", ts,
+                               r.pid, r.tid, r.arg);
+                    break;
+                case TraceEvent::Dispatch:
+                    fmt::print(f, R"({{"name":"dispatch {}","ph":"i","s":"t","ts":{:.3f},"pid":{},"tid":{},"args":{{"seq":{}}}}})", slot,
+                               ts, r.pid, r.tid, r.seq);
+                    break;
+                default:
+                    fmt::print(f, R"({{"name":"unknown {}","ph":"i","s":"t","ts":{:.3f},"pid":{},"tid":{}}})", int(r.event), ts, r.pid,
+                               r.tid);
+                    break;
+            }
+        }
+        fmt::print(f, "\n]}}\n");
+        SPDLOG_INFO("dumped {} events", records.size());
+        return 0;
+    }
+
+    int usage() {
+        fmt::print(stderr, "usage: babusTrace <domain> enable|disable|clear\n"
+                           "       babusTrace <domain> dump [out.json]\n");
+        return 1;
+    }
+
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) return usage();
+
+    std::unique_ptr<ClientDomain> domain;
+    try {
+        domain.reset(new ClientDomain(ClientDomain::open(argv[1])));
+    } catch (std::runtime_error& e) {
+        SPDLOG_ERROR("could not open domain '{}': {}", argv[1], e.what());
+        return 1;
+    }
+    TraceRing& ring = domain->ptr()->trace();
+    std::string cmd = argv[2];
+
+    if (cmd == "enable") {
+        ring.enabled.store(1);
+    } else if (cmd == "disable") {
+        ring.enabled.store(0);
+    } else if (cmd == "clear") {
+        // Invalidate every record; concurrent appenders simply continue from the new head.
+        for (auto& r : ring.records) r.stamp.store(0);
+    } else if (cmd == "dump") {
+        FILE* f = argc > 3 ? fopen(argv[3], "w") : stdout;
+        if (f == nullptr) {
+            SPDLOG_ERROR("could not open '{}' for writing", argv[3]);
+            return 1;
+        }
+        int stat = dump(domain->ptr(), f);
+        if (f != stdout) fclose(f);
+        return stat;
+    } else {
+        return usage();
+    }
+    return 0;
+}
@@ -0,0 +1,492 @@
+#include "babus/client.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace babus;
+
+//
+// Inspect and manage domains.
+//
+//      babusctl ls [domain...]                   List domains (all in /dev/shm by default), their slots and consumers.
+//      babusctl top <domain> [intervalMs] [n]    Live publish rate and bandwidth per slot.
+//      babusctl create <manifest>                Create domains and slots up front.
+//      babusctl rm [-f] <domain...>              Remove a domain and its slot files, unless live processes use them.
+//                                                Files of a build with another layout are removed regardless.
+//      babusctl rm --temp                        Remove temporary files (`.<name>.<pid>.<n>`) left by creators that died.
+//      babusctl sweep <domain...>                Remove slot files no live process has attached (see `attach.h`).
+//
+// `ls` and `top` map files read-only and never take a lock: they only load `seq`, `length`, the lock word and
+// the consumer tables, so they can run next to a loaded system without touching its hot paths. Consumers whose
+// process is gone are marked with '!'.
+//
+// A manifest is a text file of `domain <name>` and `slot <name>` lines (slots belong to the domain above
+// them). Blank lines and lines starting with '#' are ignored. Slots created this way are `SlotFlags::Persistent`,
+// so they are never swept.
+//
+
+namespace {
+
+    // A read-only mapping that tolerates missing files, unlike `MmapBuilder`.
+    struct ReadOnlyMap {
+        const void* ptr     = nullptr;
+        std::size_t len     = 0;
+        std::size_t onDisk  = 0; // Allocated bytes (the file is sparse).
+        std::size_t logical = 0;
+
+        ReadOnlyMap(const std::string& name, std::size_t size) {
+            std::string path = std::string { Prefix } + name;
+            int fd           = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) return;
+
+            struct stat st;
+            if (fstat(fd, &st) == 0) {
+                onDisk  = std::size_t(st.st_blocks) * 512;
+                logical = st.st_size;
+            }
+            if (logical >= size) {
+                void* p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+                if (p != MAP_FAILED) {
+                    ptr = p;
+                    len = size;
+                }
+            }
+            ::close(fd);
+        }
+        ~ReadOnlyMap() {
+            if (ptr) munmap(const_cast<void*>(ptr), len);
+        }
+        ReadOnlyMap(const ReadOnlyMap&)            = delete;
+        ReadOnlyMap& operator=(const ReadOnlyMap&) = delete;
+        ReadOnlyMap(ReadOnlyMap&& o)
+            : ptr(o.ptr)
+            , len(o.len)
+            , onDisk(o.onDisk)
+            , logical(o.logical) {
+            o.ptr = nullptr;
+        }
+
+        inline bool valid() const {
+            return ptr != nullptr;
+        }
+    };
+
+    bool isDomain(const ReadOnlyMap& m) {
+        return m.valid() and reinterpret_cast<const Domain*>(m.ptr)->hasCurrentLayout();
+    }
+    bool isSlot(const ReadOnlyMap& m) {
+        return m.valid() and reinterpret_cast<const Slot*>(m.ptr)->hasCurrentLayout();
+    }
+
+    // Made by a build with another layout. Nothing of this build can use it, so it is safe to remove.
+    bool isStaleDomain(const ReadOnlyMap& m) {
+        auto dom = reinterpret_cast<const Domain*>(m.ptr);
+        return m.valid() and dom->magic == DomainMagic and dom->layoutVersion != DomainLayoutVersion;
+    }
+
+    // The slot registry has not moved since layout versions were added, so stale domains from then on can still be read.
+    constexpr uint32_t FirstLayoutVersion = (1 << 16) + 1;
+
+    // The lock word is 1 when unlocked, 0 when write-locked, 1 + n with n readers.
+    std::string lockState(const Slot* slot) {
+        uint32_t v = const_cast<Slot*>(slot)->mtx.load();
+        if (v == 0) return "w";
+        if (v == 1) return "-";
+        return "r" + std::to_string(v - 1);
+    }
+
+    bool pidAlive(int32_t pid) {
+        return pid > 0 and (kill(pid, 0) == 0 or errno == EPERM);
+    }
+
+    // Pollers (see `pollfd.h`) whose mask includes this slot.
+    int numPollers(const Domain* dom, const Slot* slot) {
+        int n = 0;
+        for (const auto& e : dom->pollers.entries)
+            if (e.state.load() == PollerEntry::Active and (e.mask.load() & slot->eventMask()) and pidAlive(e.pid)) n++;
+        return n;
+    }
+
+    // Registered consumers of a slot (see `consumers.h`) and how far behind they are.
+    void printConsumers(const Slot* slot, uint32_t slotSeq) {
+        int64_t now = monotonicNanos();
+        for (const auto& e : slot->consumers().entries) {
+            if (e.state.load() != ConsumerEntry::Active) continue;
+            std::string name(e.name, strnlen(e.name, MaxNameLength));
+            fmt::print("      consumer {:<26} pid {:>7}{} lag {:>6} skipped {:>9} delivered {:>10} idle {:.1f}s\n", name, e.pid,
+                       pidAlive(e.pid) ? " " : "!", slotSeq - e.seq.load(), e.skipped.load(), e.delivered.load(),
+                       (now - e.lastReadNanos.load()) / 1e9);
+        }
+    }
+
+    // Locks taken back from threads that died holding them (see `LockOwners`), and whether that left the data invalid.
+    void printLockRecoveries(const Slot* slot) {
+        const LockOwners& o = slot->lockOwners();
+        uint32_t w = o.writerRecoveries.load(), r = o.readerRecoveries.load();
+        if (w == 0 and r == 0) return;
+        fmt::print("      lock recovered from dead writers {} readers {}{}\n", w, r,
+                   (slot->flags.bits & SlotFlags::Invalid) ? ", data invalid until the next write" : "");
+    }
+
+    // Attachments of live processes (see `attach.h`).
+    std::string numAttached(const Slot* slot) {
+        const AttachTable& at = slot->attachments();
+        uint64_t n            = 0;
+        for (const auto& e : at.pids)
+            if (pidAlive(e.load())) n++;
+        for (const auto& e : at.overflow)
+            if (uint64_t v = e.load(); v != 0 and pidAlive(int32_t(v >> 32))) n += uint32_t(v);
+        return std::to_string(n);
+    }
+
+    std::string humanBytes(double b) {
+        const char* units[] = { "B", "K", "M", "G", "T" };
+        int u               = 0;
+        while (b >= 1024 and u < 4) {
+            b /= 1024;
+            u++;
+        }
+        return fmt::format(u == 0 ? "{:.0f}{}" : "{:.1f}{}", b, units[u]);
+    }
+
+    std::vector<std::string> findDomains() {
+        std::vector<std::string> out;
+        DIR* dir = opendir(Prefix);
+        if (dir == nullptr) return out;
+        while (dirent* ent = readdir(dir)) {
+            if (ent->d_name[0] == '.') continue;
+            if (isDomain(ReadOnlyMap(ent->d_name, sizeof(Domain)))) out.push_back(ent->d_name);
+        }
+        closedir(dir);
+        std::sort(out.begin(), out.end());
+        return out;
+    }
+
+    struct SlotSample {
+        std::string name;
+        ReadOnlyMap map;
+        uint32_t seq    = 0;
+        uint32_t length = 0;
+
+        inline const Slot* slot() const {
+            return reinterpret_cast<const Slot*>(map.ptr);
+        }
+        inline void sample() {
+            if (!isSlot(map)) return;
+            seq    = slot()->seq.load();
+            length = slot()->length;
+        }
+    };
+
+    uint32_t numRegistered(const Domain* dom) {
+        uint32_t n = 0;
+        for (uint32_t i = 0; i < dom->numSlots and i < MaxSlots; i++) n += dom->slotNames[i][0] != 0;
+        return n;
+    }
+
+    std::vector<SlotSample> openSlots(const Domain* dom) {
+        std::vector<SlotSample> out;
+        for (uint32_t i = 0; i < dom->numSlots and i < MaxSlots; i++) {
+            if (dom->slotNames[i][0] == 0) continue; // Removed.
+            std::string name(dom->slotNames[i], strnlen(dom->slotNames[i], MaxNameLength));
+            out.push_back(SlotSample { name, ReadOnlyMap(name, SlotDataOffset) });
+            out.back().sample();
+        }
+        return out;
+    }
+
+    int cmdLs(const std::vector<std::string>& names) {
+        constexpr auto interval = std::chrono::milliseconds(200);
+        std::vector<std::string> domains = names.empty() ? findDomains() : names;
+
+        int stat = 0;
+        for (const auto& d : domains) {
+            ReadOnlyMap dmap(d, sizeof(Domain));
+            if (!isDomain(dmap)) {
+                SPDLOG_ERROR("'{}' is not a babus domain (or was made by a build with another layout)", d);
+                stat = 1;
+                continue;
+            }
+            const Domain* dom = reinterpret_cast<const Domain*>(dmap.ptr);
+            fmt::print("{}  slots={} seq={} pollers={}\n", d, numRegistered(dom), dom->seq.load(), dom->pollers.numActive.load());
+
+            auto slots = openSlots(dom);
+            std::vector<uint32_t> before;
+            for (auto& s : slots) before.push_back(s.seq);
+            std::this_thread::sleep_for(interval);
+
+            fmt::print("  {:>3} {:<32} {:>10} {:>10} {:>9} {:>9} {:>9} {:>10} {:>5} {:>7} {:>8}\n", "idx", "name", "seq", "length",
+                       "highwater", "file", "resident", "rate(Hz)", "lock", "pollers", "attached");
+            for (std::size_t i = 0; i < slots.size(); i++) {
+                auto& s = slots[i];
+                if (!isSlot(s.map)) {
+                    fmt::print("  {:>3} {:<32} <missing>\n", i, s.name);
+                    continue;
+                }
+                s.sample();
+                double rate = double(s.seq - before[i]) / std::chrono::duration<double>(interval).count();
+                fmt::print("  {:>3} {:<32} {:>10} {:>10} {:>9} {:>9} {:>9} {:>10.1f} {:>5} {:>7} {:>8}\n", s.slot()->index, s.name, s.seq,
+                           s.length, humanBytes(s.slot()->highWater), humanBytes(s.map.logical), humanBytes(s.map.onDisk), rate,
+                           lockState(s.slot()), numPollers(dom, s.slot()), numAttached(s.slot()));
+                if (uint64_t t = s.slot()->trimmedBytes) fmt::print("      released {} of shrunk messages so far\n", humanBytes(t));
+                printLockRecoveries(s.slot());
+                printConsumers(s.slot(), s.seq);
+            }
+        }
+        return stat;
+    }
+
+    volatile std::sig_atomic_t stopTop = 0;
+
+    int cmdTop(const std::string& d, int intervalMs, int iterations) {
+        ReadOnlyMap dmap(d, sizeof(Domain));
+        if (!isDomain(dmap)) {
+            SPDLOG_ERROR("'{}' is not a babus domain (or was made by a build with another layout)", d);
+            return 1;
+        }
+        const Domain* dom = reinterpret_cast<const Domain*>(dmap.ptr);
+        signal(SIGINT, [](int) { stopTop = 1; });
+
+        auto slots  = openSlots(dom);
+        double secs = intervalMs / 1000.;
+        bool isTty  = isatty(STDOUT_FILENO);
+        for (int it = 0; !stopTop and (iterations <= 0 or it < iterations); it++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+
+            // Slots registered or removed since the last refresh.
+            if (slots.size() != numRegistered(dom)) slots = openSlots(dom);
+
+            if (isTty) fmt::print("\033[H\033[2J");
+            fmt::print("{}  every {} ms\n", d, intervalMs);
+            fmt::print("  {:<32} {:>10} {:>12} {:>10} {:>5}\n", "name", "rate(Hz)", "bandwidth/s", "length", "lock");
+            for (auto& s : slots) {
+                if (!isSlot(s.map)) continue;
+                uint32_t prv = s.seq;
+                s.sample();
+                // Bandwidth assumes every message in the interval had the latest length.
+                double rate = double(s.seq - prv) / secs;
+                fmt::print("  {:<32} {:>10.1f} {:>12} {:>10} {:>5}\n", s.name, rate, humanBytes(rate * s.length), s.length,
+                           lockState(s.slot()));
+            }
+            fflush(stdout);
+        }
+        return 0;
+    }
+
+    int cmdCreate(const std::string& manifest) {
+        std::ifstream ifs(manifest);
+        if (!ifs) {
+            SPDLOG_ERROR("could not read manifest '{}'", manifest);
+            return 1;
+        }
+
+        std::unique_ptr<ClientDomain> domain;
+        std::string line;
+        for (int lineNo = 1; std::getline(ifs, line); lineNo++) {
+            std::istringstream ss(line);
+            std::string kind, name;
+            if (!(ss >> kind) or kind[0] == '#') continue;
+            if (!(ss >> name)) {
+                SPDLOG_ERROR("{}:{}: missing name", manifest, lineNo);
+                return 1;
+            }
+
+            if (kind == "domain") {
+                domain.reset(new ClientDomain(ClientDomain::openOrCreate(name)));
+                fmt::print("domain {}\n", name);
+            } else if (kind == "slot") {
+                if (!domain) {
+                    SPDLOG_ERROR("{}:{}: slot '{}' before any domain", manifest, lineNo, name);
+                    return 1;
+                }
+                ClientSlot& slot = domain->getSlot(name.c_str());
+                {
+                    auto lck = slot.getWriteLock();
+                    slot->flags.bits |= SlotFlags::Persistent;
+                }
+                fmt::print("  slot {} (index {})\n", name, slot.ptr()->index);
+            } else {
+                SPDLOG_ERROR("{}:{}: unknown entry '{}'", manifest, lineNo, kind);
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    // Unlink a stale domain and those of its slots that are stale too, like `ClientDomain::removeSlot()` does for slots.
+    int rmStaleDomain(const std::string& d, const ReadOnlyMap& dmap) {
+        const Domain* dom = reinterpret_cast<const Domain*>(dmap.ptr);
+        SPDLOG_WARN("'{}' was made by a build with layout version {:#x}, removing it", d, dom->layoutVersion);
+
+        uint32_t removed = 0;
+        if (dom->layoutVersion >= FirstLayoutVersion and dom->layoutVersion < DomainLayoutVersion) {
+            for (uint32_t i = 0; i < dom->numSlots and i < MaxSlots; i++) {
+                std::string name(dom->slotNames[i], strnlen(dom->slotNames[i], MaxNameLength));
+                if (name.empty()) continue;
+                ReadOnlyMap smap(name, sizeof(Slot));
+                auto slot = reinterpret_cast<const Slot*>(smap.ptr);
+                if (!smap.valid() or slot->magic != SlotMagic) continue;
+                if (slot->layoutVersion == SlotLayoutVersion) {
+                    SPDLOG_WARN("slot '{}' of stale domain '{}' has the current layout, keeping it", name, d);
+                    continue;
+                }
+                if (unlink((std::string { Prefix } + name).c_str()) == 0) removed++;
+            }
+        } else {
+            SPDLOG_WARN("can not read the slot registry of '{}', its slot files stay", d);
+        }
+
+        std::string path = std::string { Prefix } + d;
+        if (unlink(path.c_str()) != 0) {
+            SPDLOG_ERROR("unlink('{}') errno {} ('{}')", path, errno, strerror(errno));
+            return 1;
+        }
+        fmt::print("removed stale {} and {} slots\n", d, removed);
+        return 0;
+    }
+
+    // Temporary files of `MmapBuilder` are only named on file systems without `O_TMPFILE`, or by older builds. One whose
+    // creator is gone can never be published. Pids of other pid namespaces look dead too, so do not run this from a
+    // container that shares /dev/shm with creators outside it.
+    int cmdRmTemp() {
+        DIR* dir = opendir(Prefix);
+        if (dir == nullptr) return 1;
+        uint32_t removed = 0;
+        while (dirent* ent = readdir(dir)) {
+            // `.<name>.<pid>.<n>`
+            std::string f = ent->d_name;
+            auto counterDot = f.rfind('.');
+            auto pidDot     = counterDot == std::string::npos or counterDot == 0 ? std::string::npos : f.rfind('.', counterDot - 1);
+            if (f[0] != '.' or pidDot == std::string::npos or pidDot == 0) continue;
+            std::string pid = f.substr(pidDot + 1, counterDot - pidDot - 1), counter = f.substr(counterDot + 1);
+            auto isNumber   = [](const std::string& s) { return !s.empty() and std::all_of(s.begin(), s.end(), ::isdigit); };
+            if (!isNumber(pid) or !isNumber(counter) or pidAlive(std::stoi(pid))) continue;
+            if (unlinkat(dirfd(dir), f.c_str(), 0) == 0) {
+                fmt::print("removed {}\n", f);
+                removed++;
+            }
+        }
+        closedir(dir);
+        fmt::print("removed {} temporary files\n", removed);
+        return 0;
+    }
+
+    int cmdRm(const std::vector<std::string>& names, bool force) {
+        int stat = 0;
+        for (const auto& d : names) {
+            if (ReadOnlyMap dmap(d, sizeof(Domain)); isStaleDomain(dmap)) {
+                stat |= rmStaleDomain(d, dmap);
+                continue;
+            }
+            if (!isDomain(ReadOnlyMap(d, sizeof(Domain)))) {
+                SPDLOG_ERROR("'{}' is not a babus domain", d);
+                stat = 1;
+                continue;
+            }
+            ClientDomain domain = ClientDomain::open(d);
+            Domain* dom         = domain.ptr();
+
+            int live = 0;
+            for (const auto& e : dom->pollers.entries)
+                if (e.state.load() == PollerEntry::Active and pidAlive(e.pid)) live++;
+            if (live > 0 and !force) {
+                SPDLOG_ERROR("domain '{}' has {} live pollers, not removing it (use -f)", d, live);
+                stat = 1;
+                continue;
+            }
+
+            std::vector<std::string> slotNames;
+            {
+                auto lck { dom->getSlotsReadLock() };
+                for (uint32_t i = 0; i < dom->numSlots and i < MaxSlots; i++)
+                    if (dom->slotNames[i][0] != 0) slotNames.emplace_back(dom->slotNames[i], strnlen(dom->slotNames[i], MaxNameLength));
+            }
+
+            // Through the attach handshake (see `attach.h`), so a process attaching meanwhile either keeps the slot or
+            // sees it removed and opens a new file. With -f, attached processes keep working on the unlinked memory, which
+            // stays intact until the last of them unmaps it.
+            uint32_t kept = 0;
+            for (const auto& s : slotNames) {
+                if (access((std::string { Prefix } + s).c_str(), F_OK) != 0) continue;
+                if (!domain.removeSlot(s.c_str(), force)) kept++;
+            }
+            if (kept > 0) {
+                SPDLOG_ERROR("domain '{}' has {} slots that live processes have attached, not removing it (use -f)", d, kept);
+                stat = 1;
+                continue;
+            }
+
+            std::string path = std::string { Prefix } + d;
+            if (unlink(path.c_str()) != 0) {
+                SPDLOG_ERROR("unlink('{}') errno {} ('{}')", path, errno, strerror(errno));
+                stat = 1;
+                continue;
+            }
+            fmt::print("removed {} and {} slots\n", d, slotNames.size());
+        }
+        return stat;
+    }
+
+    int cmdSweep(const std::vector<std::string>& names) {
+        for (const auto& d : names) {
+            ClientDomain domain = ClientDomain::open(d);
+            fmt::print("{}: removed {} orphaned slots\n", d, domain.sweepOrphanSlots(0));
+        }
+        return 0;
+    }
+
+    int usage() {
+        fmt::print(stderr, "usage: babusctl ls [domain...]\n"
+                           "       babusctl top <domain> [intervalMs] [iterations]\n"
+                           "       babusctl create <manifest>\n"
+                           "       babusctl rm [-f] <domain...>\n"
+                           "       babusctl rm --temp\n"
+                           "       babusctl sweep <domain...>\n");
+        return 1;
+    }
+
+}
+
+int main(int argc, char** argv) {
+    spdlog::set_level(spdlog::level::warn);
+    if (argc < 2) return usage();
+
+    std::string cmd = argv[1];
+    std::vector<std::string> args(argv + 2, argv + argc);
+
+    try {
+        if (cmd == "ls") return cmdLs(args);
+        if (cmd == "top" and args.size() >= 1) {
+            int intervalMs = args.size() > 1 ? std::stoi(args[1]) : 1000;
+            if (intervalMs <= 0) {
+                SPDLOG_ERROR("top: intervalMs must be positive, got {}", intervalMs);
+                return 1;
+            }
+            return cmdTop(args[0], intervalMs, args.size() > 2 ? std::stoi(args[2]) : 0);
+        }
+        if (cmd == "create" and args.size() == 1) return cmdCreate(args[0]);
+        if (cmd == "sweep" and args.size() >= 1) return cmdSweep(args);
+        if (cmd == "rm" and args.size() == 1 and args[0] == "--temp") return cmdRmTemp();
+        if (cmd == "rm" and args.size() >= 1) {
+            bool force = args[0] == "-f";
+            if (force) args.erase(args.begin());
+            return cmdRm(args, force);
+        }
+    } catch (std::exception& e) {
+        SPDLOG_ERROR("{}", e.what());
+        return 1;
+    }
+    return usage();
+}
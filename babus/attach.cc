@@ -0,0 +1,84 @@
+#include "attach.h"
+#include "detail/rw_mutex.hpp"
+#include "stats.h"
+
+#include <spdlog/spdlog.h>
+
+namespace babus {
+
+    namespace {
+
+        inline int32_t overflowPid(uint64_t e) {
+            return int32_t(e >> 32);
+        }
+        inline uint32_t overflowCount(uint64_t e) {
+            return uint32_t(e);
+        }
+
+    }
+
+    int AttachTable::attach(int32_t pid) {
+        for (uint32_t i = 0; i < MaxEntries; i++) {
+            int32_t free = 0;
+            if (pids[i].compare_exchange_strong(free, pid)) return int(i);
+        }
+
+        // Count in this process's overflow entry, or claim a free one.
+        for (uint32_t i = 0; i < MaxOverflow; i++) {
+            uint64_t e = overflow[i].load();
+            while (e != 0 and overflowPid(e) == pid)
+                if (overflow[i].compare_exchange_weak(e, e + 1)) return int(MaxEntries + i);
+        }
+        const uint64_t first = uint64_t(uint32_t(pid)) << 32 | 1;
+        for (uint32_t i = 0; i < MaxOverflow; i++) {
+            uint64_t free = 0;
+            if (overflow[i].compare_exchange_strong(free, first)) return int(MaxEntries + i);
+        }
+
+        SPDLOG_WARN("slot attach table full, pid {} is not tracked (and the slot may be removed while attached)", pid);
+        return -1;
+    }
+
+    void AttachTable::detach(int index) {
+        if (index >= int(MaxEntries)) {
+            auto& slot = overflow[index - MaxEntries];
+            uint64_t e = slot.load();
+            while (e != 0 and !slot.compare_exchange_weak(e, overflowCount(e) == 1 ? 0 : e - 1)) { }
+        } else if (index >= 0) {
+            pids[index].store(0);
+        }
+        lastDetachNanos.store(monotonicNanos());
+    }
+
+    uint32_t AttachTable::numAlive() {
+        uint32_t n = 0;
+        for (auto& e : pids) {
+            int32_t pid = e.load();
+            if (pid == 0) continue;
+            if (LockOwners::threadIsDead(pid)) {
+                if (e.compare_exchange_strong(pid, 0)) SPDLOG_DEBUG("freed attach entry of dead pid {}", pid);
+            } else {
+                n++;
+            }
+        }
+        for (auto& o : overflow) {
+            uint64_t e = o.load();
+            if (e == 0) continue;
+            if (LockOwners::threadIsDead(overflowPid(e))) {
+                if (o.compare_exchange_strong(e, 0)) SPDLOG_DEBUG("freed overflow attach entry of dead pid {}", overflowPid(e));
+            } else {
+                n += overflowCount(e);
+            }
+        }
+        return n;
+    }
+
+    bool AttachTable::markRemoved(bool force) {
+        removed.store(1);
+        if (force) return true;
+        if (numAlive() == 0) return true;
+        removed.store(0);
+        return false;
+    }
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "babus/common.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace babus {
+
+    //
+    // Each slot file records which processes have it mapped (at `SlotAttachOffset`), so files nobody uses any more can
+    // be removed from /dev/shm instead of piling up. `ClientSlot` attaches when opened and detaches when destroyed. A
+    // process that died without detaching is recognized by its pid being gone.
+    //
+    // `ClientDomain::removeSlot()` removes a slot on request. `ClientDomain::sweepOrphanSlots()` (or `babusctl sweep`)
+    // removes slots without live attachers that have been idle for a while. It only runs when called: a slot nobody has
+    // attached may still hold the last message of a producer that exited, for readers that start later. Slots flagged
+    // `SlotFlags::Persistent` (e.g. by `babusctl create`) are never swept.
+    //
+    // A remover and an attacher racing on the same file use a Dekker-style handshake: the remover sets `removed` and
+    // then looks for attachers, an attacher attaches and then looks at `removed`. At least one of them sees the other,
+    // so nobody ends up attached to an unlinked file.
+    //
+
+    struct AttachTable {
+        static constexpr uint32_t MaxEntries  = 44;
+        static constexpr uint32_t MaxOverflow = 8;
+
+        std::atomic<uint32_t> removed;        // Set by a remover. Attachers that see it open the path again.
+        uint32_t pad_;
+        std::atomic<int64_t> lastDetachNanos; // `monotonicNanos()` of the last detach.
+        std::atomic<int32_t> pids[MaxEntries]; // One entry per attach. Zero is free.
+        // Attaches that found `pids` full, counted per process: `pid << 32 | count`. Zero is free. Like `pids`, an
+        // entry of a dead process is freed by the next liveness check.
+        std::atomic<uint64_t> overflow[MaxOverflow];
+
+        // Index of the claimed entry (`MaxEntries + i` for `overflow[i]`), or -1 if both tables were full and the
+        // attach is not tracked: the file may then be removed while this process maps it, as with a forced removal.
+        int attach(int32_t pid);
+        void detach(int index);
+
+        // Attachers whose process still exists. Entries of dead ones are freed on the way.
+        uint32_t numAlive();
+
+        // The remover's side of the handshake. Returns false, and takes the mark back, if anyone is still attached.
+        // With `force`, marks the file removed regardless.
+        bool markRemoved(bool force);
+    };
+
+    static_assert(sizeof(AttachTable) == 256, "AttachTable should stay 256 bytes");
+    static_assert(SlotAttachOffset + sizeof(AttachTable) <= SlotConsumersOffset, "AttachTable does not fit before SlotConsumersOffset");
+
+}
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+//
+// Latency recording shared by the profilers.
+//
+// `LatencyHistogram` is HDR-style: log-linear buckets with 16 sub-buckets per power of two, so any
+// recorded value is reported within ~6% and the tail (p99.9, max) is kept instead of averaged away.
+//
+// `ProfileResults` collects one row per (role, name, metric) and writes them as CSV and JSON next to the
+// human readable log, so runs can be compared across kernels and configs. Profilers that fork send their
+// rows to the parent with `sendRow`/`recvRow`.
+//
+
+namespace {
+
+    // Nanoseconds, not subject to NTP slewing, and comparable between processes on one machine.
+    inline int64_t nowNanos() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+        return int64_t(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+    }
+
+    inline std::string fmtDuration(double nanos) {
+        if (nanos > 1e9)
+            return fmt::format("{:>6.1f} s", nanos / 1e9);
+        else if (nanos > 1e6)
+            return fmt::format("{:>6.1f}ms", nanos / 1e6);
+        else if (nanos > 1e3)
+            return fmt::format("{:>6.1f}us", nanos / 1e3);
+        else
+            return fmt::format("{:>6.0f}ns", nanos);
+    }
+
+    struct LatencyHistogram {
+        static constexpr int SubBits    = 4;
+        static constexpr int SubBuckets = 1 << SubBits;
+        static constexpr int NumBuckets = 64 * SubBuckets;
+
+        std::vector<uint64_t> counts = std::vector<uint64_t>(NumBuckets, 0);
+        uint64_t n                   = 0;
+        double sum                   = 0;
+        int64_t max                  = 0;
+
+        static inline int bucketOf(int64_t v) {
+            if (v < SubBuckets) return v < 0 ? 0 : int(v);
+            int msb   = 63 - __builtin_clzll(uint64_t(v));
+            int shift = msb - SubBits;
+            return (shift + 1) * SubBuckets + int((v >> shift) - SubBuckets);
+        }
+        // Largest value that falls in bucket `b`.
+        static inline int64_t bucketUpper(int b) {
+            if (b < SubBuckets) return b;
+            int shift   = b / SubBuckets - 1;
+            int64_t top = b % SubBuckets + SubBuckets;
+            return ((top + 1) << shift) - 1;
+        }
+
+        inline void record(int64_t v) {
+            counts[bucketOf(v)]++;
+            n++;
+            sum += v;
+            max = std::max(max, v);
+        }
+
+        inline void merge(const LatencyHistogram& o) {
+            for (int b = 0; b < NumBuckets; b++) counts[b] += o.counts[b];
+            n += o.n;
+            sum += o.sum;
+            max = std::max(max, o.max);
+        }
+
+        inline double mean() const {
+            return n == 0 ? 0 : sum / n;
+        }
+
+        // `q` in [0, 1]. Zero if empty.
+        inline int64_t percentile(double q) const {
+            if (n == 0) return 0;
+            uint64_t target = std::max<uint64_t>(1, uint64_t(q * n + .5)), seen = 0;
+            for (int b = 0; b < NumBuckets; b++) {
+                seen += counts[b];
+                if (seen >= target) return std::min(bucketUpper(b), max);
+            }
+            return max;
+        }
+
+        inline std::string summary() const {
+            return fmt::format("p50 {} p90 {} p99 {} p99.9 {} max {} (n {:>9})", fmtDuration(percentile(.5)), fmtDuration(percentile(.9)),
+                               fmtDuration(percentile(.99)), fmtDuration(percentile(.999)), fmtDuration(max), n);
+        }
+    };
+
+    struct ProfileResults {
+        struct Row {
+            std::string role; // producer / consumer
+            std::string name;
+            std::string metric;
+            LatencyHistogram hist;
+            uint64_t missed = 0;
+            double seconds  = 0; // Wall time the row covers, if known, for `rate_hz`.
+            std::string transport; // Overrides the one passed to `write`, for side-by-side comparisons.
+        };
+
+        std::mutex mtx;
+        std::vector<Row> rows;
+
+        inline void add(const std::string& role, const std::string& name, const std::string& metric, const LatencyHistogram& hist,
+                        uint64_t missed = 0, double seconds = 0) {
+            std::lock_guard<std::mutex> lck(mtx);
+            rows.push_back(Row { role, name, metric, hist, missed, seconds });
+        }
+        inline void add(const Row& row) {
+            std::lock_guard<std::mutex> lck(mtx);
+            rows.push_back(row);
+        }
+
+        // Writes `<prefix>.csv` and `<prefix>.json`. Latencies are in nanoseconds.
+        inline void write(const std::string& prefix, const std::string& transport) {
+            std::lock_guard<std::mutex> lck(mtx);
+
+            FILE* csv  = fopen((prefix + ".csv").c_str(), "w");
+            FILE* json = fopen((prefix + ".json").c_str(), "w");
+            if (csv == nullptr or json == nullptr) {
+                SPDLOG_ERROR("could not open '{}.csv/json' for writing", prefix);
+                if (csv) fclose(csv);
+                if (json) fclose(json);
+                return;
+            }
+
+            fmt::print(csv, "transport,role,name,metric,n,missed,rate_hz,mean_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n");
+            fmt::print(json, "[\n");
+            for (std::size_t i = 0; i < rows.size(); i++) {
+                const Row& r  = rows[i];
+                const auto& h = r.hist;
+                double rate   = r.seconds > 0 ? h.n / r.seconds : 0;
+                const auto& t = r.transport.empty() ? transport : r.transport;
+                fmt::print(csv, "{},{},\"{}\",{},{},{},{:.1f},{:.0f},{},{},{},{},{}\n", t, r.role, r.name, r.metric, h.n, r.missed,
+                           rate, h.mean(), h.percentile(.5), h.percentile(.9), h.percentile(.99), h.percentile(.999), h.max);
+                fmt::print(json,
+                           R"(  {{"transport":"{}","role":"{}","name":"{}","metric":"{}","n":{},"missed":{},"rate_hz":{:.1f},"mean_ns":{:.0f},)"
+                           R"("p50_ns":{},"p90_ns":{},"p99_ns":{},"p999_ns":{},"max_ns":{}}}{})"
+                           "\n",
+                           t, r.role, r.name, r.metric, h.n, r.missed, rate, h.mean(), h.percentile(.5), h.percentile(.9),
+                           h.percentile(.99), h.percentile(.999), h.max, i + 1 < rows.size() ? "," : "");
+            }
+            fmt::print(json, "]\n");
+            fclose(csv);
+            fclose(json);
+            SPDLOG_INFO("wrote {} rows to '{}.csv' and '{}.json'", rows.size(), prefix, prefix);
+        }
+    };
+
+    // -----------------------------------------------------
+    // Rows over a pipe, from forked children to their parent
+    // -----------------------------------------------------
+
+    struct WireRow {
+        char role[16];
+        char name[112];
+        char metric[16];
+        uint64_t n;
+        uint64_t missed;
+        double sum;
+        int64_t max;
+        double seconds;
+        uint64_t counts[LatencyHistogram::NumBuckets];
+    };
+
+    inline bool writeFull(int fd, const void* buf, std::size_t len) {
+        const uint8_t* p = (const uint8_t*)buf;
+        while (len > 0) {
+            ssize_t n = ::write(fd, p, len);
+            if (n < 0 and errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    // False on EOF or error.
+    inline bool readFull(int fd, void* buf, std::size_t len) {
+        uint8_t* p = (uint8_t*)buf;
+        while (len > 0) {
+            ssize_t n = ::read(fd, p, len);
+            if (n < 0 and errno == EINTR) continue;
+            if (n <= 0) return false;
+            p += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    inline void sendRow(int fd, const ProfileResults::Row& r) {
+        auto w = std::make_unique<WireRow>();
+        memset(w.get(), 0, sizeof(WireRow));
+        snprintf(w->role, sizeof(w->role), "%s", r.role.c_str());
+        snprintf(w->name, sizeof(w->name), "%s", r.name.c_str());
+        snprintf(w->metric, sizeof(w->metric), "%s", r.metric.c_str());
+        w->n       = r.hist.n;
+        w->missed  = r.missed;
+        w->sum     = r.hist.sum;
+        w->max     = r.hist.max;
+        w->seconds = r.seconds;
+        std::copy(r.hist.counts.begin(), r.hist.counts.end(), w->counts);
+        if (!writeFull(fd, w.get(), sizeof(WireRow))) SPDLOG_ERROR("could not send results to parent: {}", strerror(errno));
+    }
+
+    // Blocks until a row arrives. False once the sender closed the pipe.
+    inline bool recvRow(int fd, ProfileResults::Row& out) {
+        auto w = std::make_unique<WireRow>();
+        if (!readFull(fd, w.get(), sizeof(WireRow))) return false;
+        out.role    = w->role;
+        out.name    = w->name;
+        out.metric  = w->metric;
+        out.missed  = w->missed;
+        out.seconds = w->seconds;
+        out.hist    = LatencyHistogram {};
+        std::copy(w->counts, w->counts + LatencyHistogram::NumBuckets, out.hist.counts.begin());
+        out.hist.n   = w->n;
+        out.hist.sum = w->sum;
+        out.hist.max = w->max;
+        return true;
+    }
+
+}
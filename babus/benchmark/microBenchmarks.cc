@@ -0,0 +1,463 @@
+#include "babus/client.h"
+#include "babus/domain.h"
+#include "babus/publisher.h"
+#include "babus/typed.h"
+#include "babus/waiter.h"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+//
+// Microbenchmarks of the babus primitives. Use Google Benchmark's flags, e.g. to track regressions:
+//
+//      ./runMicroBenchmarks --benchmark_out=micro.json --benchmark_out_format=json
+//      ./runMicroBenchmarks --benchmark_filter=SlotWrite
+//
+// Primitives run on malloc'd `Domain`/`Slot`s (like the tests) so no files are involved, except for
+// `getSlot`, which needs a real `ClientDomain`.
+//
+
+using namespace babus;
+
+namespace {
+
+    Domain* mallocDomain() {
+        void* p = calloc(1, DomainFileSize);
+        new (p) Domain {};
+        return (Domain*)p;
+    }
+    Slot* mallocSlot(uint32_t index = 0) {
+        void* p = calloc(1, SlotFileSize);
+        new (p) Slot {};
+        Slot* slot  = (Slot*)p;
+        slot->index = index;
+        snprintf(slot->name, sizeof(slot->name), "bench%u", index);
+        return slot;
+    }
+
+    // Message sizes from 64 B up to 8 MiB: the largest power of 8 that fits `SlotDataCapacity`.
+    void messageSizes(benchmark::internal::Benchmark* b) {
+        b->RangeMultiplier(8)->Range(64, 8 << 20);
+    }
+
+    // -----------------------------------------------------
+    // RwMutex
+    // -----------------------------------------------------
+
+    void BM_RwMutexWriteUncontended(benchmark::State& state) {
+        RwMutex mtx;
+        for (auto _ : state) {
+            mtx.w_lock();
+            mtx.w_unlock();
+        }
+    }
+    BENCHMARK(BM_RwMutexWriteUncontended);
+
+    void BM_RwMutexReadUncontended(benchmark::State& state) {
+        RwMutex mtx;
+        for (auto _ : state) {
+            mtx.r_lock();
+            mtx.r_unlock();
+        }
+    }
+    BENCHMARK(BM_RwMutexReadUncontended);
+
+    RwMutex sharedMutex;
+
+    void BM_RwMutexWriteContended(benchmark::State& state) {
+        for (auto _ : state) {
+            sharedMutex.w_lock();
+            sharedMutex.w_unlock();
+        }
+    }
+    BENCHMARK(BM_RwMutexWriteContended)->ThreadRange(2, 8)->UseRealTime();
+
+    void BM_RwMutexReadContended(benchmark::State& state) {
+        for (auto _ : state) {
+            sharedMutex.r_lock();
+            sharedMutex.r_unlock();
+        }
+    }
+    BENCHMARK(BM_RwMutexReadContended)->ThreadRange(2, 8)->UseRealTime();
+
+    // -----------------------------------------------------
+    // SequenceCounter
+    // -----------------------------------------------------
+
+    void BM_SequenceCounterIncrementNoWake(benchmark::State& state) {
+        SequenceCounter seq;
+        for (auto _ : state) benchmark::DoNotOptimize(seq.incrementNoFutexWake());
+    }
+    BENCHMARK(BM_SequenceCounterIncrementNoWake);
+
+    // `increment` always issues FUTEX_WAKE_BITSET; arg 0 has nobody waiting, arg 1 has a thread waiting on
+    // the same bit (which goes straight back to waiting after each wake).
+    void BM_SequenceCounterIncrement(benchmark::State& state) {
+        SequenceCounter seq;
+        std::atomic<bool> stop { false };
+        std::thread waiter;
+        if (state.range(0) > 0) {
+            waiter = std::thread([&]() {
+                while (!stop) seq.waitForChange(seq.load(), 1);
+            });
+            usleep(10'000);
+        }
+
+        for (auto _ : state) seq.increment(1);
+
+        stop = true;
+        seq.increment(1);
+        if (waiter.joinable()) waiter.join();
+    }
+    BENCHMARK(BM_SequenceCounterIncrement)->Arg(0)->Arg(1)->UseRealTime();
+
+    // -----------------------------------------------------
+    // Slot
+    // -----------------------------------------------------
+
+    void BM_SlotWrite(benchmark::State& state) {
+        Domain* dom = mallocDomain();
+        Slot* slot  = mallocSlot();
+        std::vector<uint8_t> msg(state.range(0), 7);
+
+        for (auto _ : state) slot->write(dom, { msg.data(), msg.size() });
+        state.SetBytesProcessed(int64_t(state.iterations()) * state.range(0));
+
+        free(slot);
+        free(dom);
+    }
+    BENCHMARK(BM_SlotWrite)->Apply(messageSizes);
+
+    void BM_SlotReadClone(benchmark::State& state) {
+        Domain* dom = mallocDomain();
+        Slot* slot  = mallocSlot();
+        std::vector<uint8_t> msg(state.range(0), 7);
+        slot->write(dom, { msg.data(), msg.size() });
+
+        for (auto _ : state) {
+            auto view = slot->read();
+            benchmark::DoNotOptimize(view.cloneBytes());
+        }
+        state.SetBytesProcessed(int64_t(state.iterations()) * state.range(0));
+
+        free(slot);
+        free(dom);
+    }
+    BENCHMARK(BM_SlotReadClone)->Apply(messageSizes);
+
+    void BM_SlotReadView(benchmark::State& state) {
+        Domain* dom = mallocDomain();
+        Slot* slot  = mallocSlot();
+        uint64_t v  = 1;
+        slot->write(dom, { &v, sizeof(v) });
+
+        for (auto _ : state) {
+            auto view = slot->read();
+            benchmark::DoNotOptimize(view.span.ptr);
+        }
+
+        free(slot);
+        free(dom);
+    }
+    BENCHMARK(BM_SlotReadView);
+
+    // A composite message: 64 byte header, an image plane of `range(0)` bytes and 256 bytes of metadata. `writev`
+    // copies the pieces straight into the slot, `Concat` first assembles them in a buffer like callers had to before.
+    void BM_SlotWritev(benchmark::State& state) {
+        Domain* dom = mallocDomain();
+        Slot* slot  = mallocSlot();
+        std::vector<uint8_t> header(64, 1), plane(state.range(0), 2), meta(256, 3);
+
+        for (auto _ : state)
+            slot->writev(dom, { { header.data(), header.size() }, { plane.data(), plane.size() }, { meta.data(), meta.size() } });
+        state.SetBytesProcessed(int64_t(state.iterations()) * (header.size() + plane.size() + meta.size()));
+
+        free(slot);
+        free(dom);
+    }
+    BENCHMARK(BM_SlotWritev)->Apply(messageSizes);
+
+    void BM_SlotWriteConcat(benchmark::State& state) {
+        Domain* dom = mallocDomain();
+        Slot* slot  = mallocSlot();
+        std::vector<uint8_t> header(64, 1), plane(state.range(0), 2), meta(256, 3), buf;
+
+        for (auto _ : state) {
+            buf.clear();
+            buf.insert(buf.end(), header.begin(), header.end());
+            buf.insert(buf.end(), plane.begin(), plane.end());
+            buf.insert(buf.end(), meta.begin(), meta.end());
+            slot->write(dom, { buf.data(), buf.size() });
+        }
+        state.SetBytesProcessed(int64_t(state.iterations()) * (header.size() + plane.size() + meta.size()));
+
+        free(slot);
+        free(dom);
+    }
+    BENCHMARK(BM_SlotWriteConcat)->Apply(messageSizes);
+
+    // The reading side: header and metadata into structs, the plane into an existing buffer.
+    void BM_LockedViewReadv(benchmark::State& state) {
+        Domain* dom = mallocDomain();
+        Slot* slot  = mallocSlot();
+        std::vector<uint8_t> header(64, 1), plane(state.range(0), 2), meta(256, 3);
+        slot->writev(dom, { { header.data(), header.size() }, { plane.data(), plane.size() }, { meta.data(), meta.size() } });
+
+        for (auto _ : state) {
+            auto view = slot->read();
+            benchmark::DoNotOptimize(view.readv({ { 0, { header.data(), header.size() } },
+                                                  { header.size(), { plane.data(), plane.size() } },
+                                                  { header.size() + plane.size(), { meta.data(), meta.size() } } }));
+        }
+        state.SetBytesProcessed(int64_t(state.iterations()) * (header.size() + plane.size() + meta.size()));
+
+        free(slot);
+        free(dom);
+    }
+    BENCHMARK(BM_LockedViewReadv)->Apply(messageSizes);
+
+    // Writing and reading whole frames, 1080p RGB and 4K at 2 bytes per pixel (4K RGB does not fit a slot), with the
+    // copy kernel's non-temporal stores (second arg 1) and with plain `memcpy` (0).
+    void frameSizes(benchmark::internal::Benchmark* b) {
+        b->ArgsProduct({ { 1920 * 1080 * 3, 3840 * 2160 * 2 }, { 0, 1 } });
+    }
+
+    void BM_SlotWriteFrame(benchmark::State& state) {
+        Domain* dom = mallocDomain();
+        Slot* slot  = mallocSlot();
+        std::vector<uint8_t> frame(state.range(0), 1);
+        std::size_t before = streamingCopyThreshold();
+        setStreamingCopyThreshold(state.range(1) ? 1 : 0);
+
+        for (auto _ : state) slot->write(dom, { frame.data(), frame.size() });
+        state.SetBytesProcessed(int64_t(state.iterations()) * frame.size());
+        state.SetLabel(state.range(1) ? copyKernelName() : "memcpy");
+
+        setStreamingCopyThreshold(before);
+        free(slot);
+        free(dom);
+    }
+    BENCHMARK(BM_SlotWriteFrame)->Apply(frameSizes);
+
+    void BM_SlotReadFrame(benchmark::State& state) {
+        Domain* dom = mallocDomain();
+        Slot* slot  = mallocSlot();
+        std::vector<uint8_t> frame(state.range(0), 1);
+        slot->write(dom, { frame.data(), frame.size() });
+        std::size_t before = streamingCopyThreshold();
+        setStreamingCopyThreshold(state.range(1) ? 1 : 0);
+
+        for (auto _ : state) {
+            auto view = slot->read();
+            benchmark::DoNotOptimize(view.readv({ { 0, { frame.data(), frame.size() } } }));
+        }
+        state.SetBytesProcessed(int64_t(state.iterations()) * frame.size());
+        state.SetLabel(state.range(1) ? copyKernelName() : "memcpy");
+
+        setStreamingCopyThreshold(before);
+        free(slot);
+        free(dom);
+    }
+    BENCHMARK(BM_SlotReadFrame)->Apply(frameSizes);
+
+    // A 4K 16-bit frame written with 0, 1 and 3 copy helpers. The time is how long the write lock is held.
+    void BM_SlotWriteParallel(benchmark::State& state) {
+        Domain* dom = mallocDomain();
+        Slot* slot  = mallocSlot();
+        std::vector<uint8_t> frame(3840 * 2160 * 2, 1);
+        setParallelCopy(state.range(0), 1 << 20);
+
+        for (auto _ : state) slot->write(dom, { frame.data(), frame.size() });
+        state.SetBytesProcessed(int64_t(state.iterations()) * frame.size());
+
+        setParallelCopy(0);
+        free(slot);
+        free(dom);
+    }
+    BENCHMARK(BM_SlotWriteParallel)->Arg(0)->Arg(1)->Arg(3)->UseRealTime();
+
+    // A producer of 1080p RGB frames that fills a buffer and then writes it (0), or hands it to an `AsyncPublisher`
+    // and fills a recycled one next (1). Filling is a copy from `frame`, and is timed in both.
+    void BM_SlotWriteAsync(benchmark::State& state) {
+        Domain* dom = mallocDomain();
+        Slot* slot  = mallocSlot();
+        std::vector<uint8_t> frame(1920 * 1080 * 3, 1);
+        std::vector<uint8_t> buffer(frame.size());
+        {
+            AsyncPublisher publisher { slot, dom, 2 };
+            for (auto _ : state) {
+                if (state.range(0) == 0) {
+                    memcpy(buffer.data(), frame.data(), frame.size());
+                    slot->write(dom, { buffer.data(), buffer.size() });
+                    continue;
+                }
+                std::vector<uint8_t> next = publisher.takeBuffer();
+                next.resize(frame.size());
+                memcpy(next.data(), frame.data(), frame.size());
+                publisher.write(std::move(next), nullptr);
+            }
+            publisher.flush();
+            state.counters["dropped"] = publisher.dropped();
+        }
+        state.SetLabel(state.range(0) ? "writeAsync" : "write");
+
+        free(slot);
+        free(dom);
+    }
+    BENCHMARK(BM_SlotWriteAsync)->Arg(0)->Arg(1)->UseRealTime();
+
+    // A 1080p RGB frame read three ways: the whole frame, a quarter-size crop, and downsampled by 2 and 4.
+    void BM_ImageRead1080p(benchmark::State& state) {
+        Domain* dom = mallocDomain();
+        Slot* slot  = mallocSlot();
+        ImageLayout layout { 1920, 1080, 1920 * 3, PixelFormat::Rgb8 };
+        std::vector<uint8_t> frame(layout.byteSize(), 7), out(layout.byteSize());
+        slot->writeImage(dom, layout, { frame.data(), frame.size() });
+
+        std::size_t bytes = 0;
+        for (auto _ : state) {
+            auto view       = slot->read();
+            ImageView image = view.imageView();
+            switch (state.range(0)) {
+                case 0: bytes = view.readv({ { 0, { out.data(), out.size() } } }); break;
+                case 1: bytes = image.copyRegion({ 480, 270, 960, 540 }, out.data(), out.size()); break;
+                default: bytes = image.copyDownsampled(state.range(0), out.data(), out.size()); break;
+            }
+            benchmark::DoNotOptimize(out.data());
+        }
+        state.SetBytesProcessed(int64_t(state.iterations()) * bytes);
+        state.SetLabel(state.range(0) == 0 ? "full" : state.range(0) == 1 ? "roi 960x540" : fmt::format("1/{}", state.range(0)));
+
+        free(slot);
+        free(dom);
+    }
+    BENCHMARK(BM_ImageRead1080p)->Arg(0)->Arg(1)->Arg(2)->Arg(4);
+
+    // A small fixed-size message, like an IMU sample.
+    struct Msg128 {
+        uint8_t bytes[128];
+    };
+
+    void BM_SlotWrite128Bytes(benchmark::State& state) {
+        Domain* dom = mallocDomain();
+        Slot* slot  = mallocSlot();
+        Msg128 msg {};
+
+        for (auto _ : state) slot->write(dom, { &msg, sizeof(msg) });
+
+        free(slot);
+        free(dom);
+    }
+    BENCHMARK(BM_SlotWrite128Bytes);
+
+    // Same as above through `TypedSlot`, where the copy size is a compile time constant.
+    void BM_TypedSlotWrite128(benchmark::State& state) {
+        Domain* dom = mallocDomain();
+        Slot* slot  = mallocSlot();
+        TypedSlot<Msg128> typed { slot, dom };
+        Msg128 msg {};
+
+        for (auto _ : state) typed.write(msg);
+
+        free(slot);
+        free(dom);
+    }
+    BENCHMARK(BM_TypedSlotWrite128);
+
+    void BM_TypedSlotRead128(benchmark::State& state) {
+        Domain* dom = mallocDomain();
+        Slot* slot  = mallocSlot();
+        TypedSlot<Msg128> typed { slot, dom };
+        typed.write(Msg128 {});
+
+        for (auto _ : state) benchmark::DoNotOptimize(typed.read().copy());
+
+        free(slot);
+        free(dom);
+    }
+    BENCHMARK(BM_TypedSlotRead128);
+
+    // -----------------------------------------------------
+    // Waiter
+    // -----------------------------------------------------
+
+    // Time from a write until every one of `range(0)` subscriber threads (each with its own `Waiter`)
+    // has woken and visited the slot.
+    void BM_WaiterWakeLatency(benchmark::State& state) {
+        const int numSubscribers = state.range(0);
+        Domain* dom              = mallocDomain();
+        Slot* slot               = mallocSlot();
+        Slot* stopSlot           = mallocSlot(1);
+
+        std::atomic<int> numVisited { 0 }, numReady { 0 };
+        std::atomic<bool> stop { false };
+        std::vector<std::thread> subscribers;
+        for (int i = 0; i < numSubscribers; i++) {
+            subscribers.emplace_back([&]() {
+                Waiter waiter(dom);
+                waiter.subscribeTo(slot);
+                waiter.subscribeTo(stopSlot);
+                numReady++;
+                while (!stop) {
+                    // Sample before visiting, so a write in between makes the wait return.
+                    uint32_t prv = dom->seq.load();
+                    waiter.forEachNewSlot([&](LockedView&& view) {
+                        if (view.slot == slot) numVisited++;
+                    });
+                    dom->seq.waitForChange(prv, waiter.wakeMask());
+                }
+            });
+        }
+        while (numReady.load() < numSubscribers) std::this_thread::yield();
+
+        uint64_t v = 0;
+        for (auto _ : state) {
+            numVisited = 0;
+            slot->write(dom, { &v, sizeof(v) });
+            while (numVisited.load() < numSubscribers) std::this_thread::yield();
+        }
+
+        stop = true;
+        stopSlot->write(dom, { &v, sizeof(v) });
+        for (auto& t : subscribers) t.join();
+        free(stopSlot);
+        free(slot);
+        free(dom);
+    }
+    BENCHMARK(BM_WaiterWakeLatency)->RangeMultiplier(2)->Range(1, 16)->UseRealTime();
+
+    // -----------------------------------------------------
+    // ClientDomain
+    // -----------------------------------------------------
+
+    void BM_GetSlotLookup(benchmark::State& state) {
+        ClientDomain domain = ClientDomain::openOrCreate("microBenchDomain");
+        std::vector<std::string> names;
+        for (int i = 0; i < state.range(0); i++) {
+            names.push_back("microBench" + std::to_string(i));
+            domain.getSlot(names.back().c_str());
+        }
+
+        std::size_t i = 0;
+        for (auto _ : state) benchmark::DoNotOptimize(&domain.getSlot(names[i++ % names.size()].c_str()));
+    }
+    BENCHMARK(BM_GetSlotLookup)->Arg(1)->Arg(8)->Arg(32);
+
+}
+
+int main(int argc, char** argv) {
+    spdlog::set_level(spdlog::level::warn);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    // Remove the files `BM_GetSlotLookup` created.
+    unlink((std::string { Prefix } + "microBenchDomain").c_str());
+    for (int i = 0; i < 32; i++) unlink((std::string { Prefix } + "microBench" + std::to_string(i)).c_str());
+    return 0;
+}
@@ -3,10 +3,11 @@
 #include "babus/waiter.h"
 
 #include <cassert>
-#include <chrono>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "babus/benchmark/histogram.hpp"
 #include "babus/benchmark/profileCfg.hpp"
 
 //
@@ -24,21 +25,7 @@
 
 namespace {
 	ProfileConfig g_cfg;
-
-    int64_t getMicros() {
-        using namespace std::chrono;
-        auto tp = high_resolution_clock::now();
-        return duration_cast<microseconds>(tp.time_since_epoch()).count();
-    }
-
-    inline std::string fmtDuration(double micros) {
-        if (micros > 1'000'000)
-            return fmt::format("{:>5.1f} s", micros / 1e6);
-        else if (micros > 1'000)
-            return fmt::format("{:>5.1f}ms", micros / 1e3);
-        else
-            return fmt::format("{:>5.1f}us", micros);
-    }
+	ProfileResults g_results;
 
     using MessageBuffer = std::vector<uint8_t>;
 
@@ -46,14 +33,14 @@ namespace {
         assert(len > sizeof(int64_t));
         MessageBuffer out(len);
         for (std::size_t i = sizeof(int64_t); i < len; i++) out[i] = (i % 256);
-        reinterpret_cast<int64_t*>(out.data())[0] = getMicros();
+        reinterpret_cast<int64_t*>(out.data())[0] = nowNanos();
         return out;
     }
     inline int64_t getDuration(int64_t then) {
-        return getMicros() - then;
+        return nowNanos() - then;
     }
     inline int64_t getElapsedFromMessageCreation(const uint8_t* buf) {
-        int64_t now  = getMicros();
+        int64_t now  = nowNanos();
         int64_t then = reinterpret_cast<const int64_t*>(buf)[0];
         // SPDLOG_INFO("now {} then {} diff {}", now, then, now-then);
         return now - then;
@@ -73,10 +60,7 @@ namespace {
         std::size_t msgSize;
         std::thread thread;
 
-        struct {
-            int64_t writeLatency = 0;
-            int64_t n            = 0;
-        } sum;
+        LatencyHistogram writeLatency;
 
         inline Producer(std::string name, std::string slotName, int frequency, std::size_t msgSize)
             : name(name)
@@ -107,8 +91,8 @@ namespace {
             // SPDLOG_TRACE("Producer '{}' dtor, waiting for join", name);
             thread.join();
             // SPDLOG_TRACE("Producer '{}' dtor, waiting for join ... done", name);
-            SPDLOG_INFO("Producer '{:>40}' avg latency of write       : {} (n {:>12L})", name,
-                        fmtDuration(static_cast<double>(sum.writeLatency) / sum.n), sum.n);
+            SPDLOG_INFO("Producer '{:>40}' latency of write       : {}", name, writeLatency.summary());
+            g_results.add("producer", name, "write", writeLatency);
         }
 
         inline void loop() {
@@ -121,10 +105,9 @@ namespace {
                 usleep(sleepTime);
 
                 auto msg             = allocMessage(msgSize);
-                int64_t startOfWrite = getMicros();
+                int64_t startOfWrite = nowNanos();
                 clientSlot.write({ msg.data(), msg.size() });
-                sum.writeLatency += getDuration(startOfWrite);
-                sum.n++;
+                writeLatency.record(getDuration(startOfWrite));
             }
         }
     };
@@ -135,11 +118,9 @@ namespace {
         int sleepTime;
         std::thread thread;
 
-        struct {
-            int64_t viewLatency = 0;
-            int64_t copyLatency = 0;
-            int64_t n           = 0;
-        } sum;
+        LatencyHistogram viewLatency;
+        LatencyHistogram copyLatency;
+        uint64_t missed = 0; // Messages overwritten before we visited them.
 
         inline Consumer(std::string name, const std::vector<std::string>& slotNames, int sleepTime = 0)
             : name(name)
@@ -160,10 +141,10 @@ namespace {
             thread.join();
             // SPDLOG_TRACE("Consumer '{}' dtor, waiting for join ... done", name);
 
-            SPDLOG_INFO("Consumer '{:>40}' avg latency of view        : {} (n {:>12L})", name,
-                        fmtDuration(static_cast<double>(sum.viewLatency) / sum.n), sum.n);
-            SPDLOG_INFO("Consumer '{:>40}' avg latency of view + copy : {} (n {:>12L})", name,
-                        fmtDuration(static_cast<double>(sum.copyLatency) / sum.n), sum.n);
+            SPDLOG_INFO("Consumer '{:>40}' latency of view        : {}", name, viewLatency.summary());
+            SPDLOG_INFO("Consumer '{:>40}' latency of view + copy : {} (missed {})", name, copyLatency.summary(), missed);
+            g_results.add("consumer", name, "view", viewLatency, missed);
+            g_results.add("consumer", name, "view+copy", copyLatency, missed);
         }
 
         inline void loop() {
@@ -185,11 +166,11 @@ namespace {
             while (!_doStop) {
 
                 waiter.waitExclusive();
-                waiter.forEachNewSlot([&](babus::LockedView&& view) {
-                    sum.viewLatency += getElapsedFromMessageCreation((const uint8_t*)view.span.ptr);
+                waiter.forEachNewSlot([&](babus::LockedView&& view, uint32_t skipped) {
+                    viewLatency.record(getElapsedFromMessageCreation((const uint8_t*)view.span.ptr));
                     auto msg = view.cloneBytes();
-                    sum.copyLatency += getElapsedFromMessageCreation((const uint8_t*)msg.data());
-                    sum.n++;
+                    copyLatency.record(getElapsedFromMessageCreation((const uint8_t*)msg.data()));
+                    missed += skipped;
                 });
 
                 /*
@@ -263,6 +244,7 @@ template <class... Args> void run_app(Args&&... args) {
         App app(args...);
         app.run(g_cfg.testDuration);
     }
+    if (!g_cfg.outputPrefix.empty()) g_results.write(g_cfg.outputPrefix, "babus");
 
     delete _clientDomain;
     _clientDomain = 0;
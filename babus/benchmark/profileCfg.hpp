@@ -22,6 +22,9 @@ namespace {
 		int imuRate;
 
 		int64_t testDuration;
+
+		// If set, results are also written to `<outputPrefix>.csv` and `.json`.
+		std::string outputPrefix;
 	};
 
 	inline bool getOn(const char* key, bool def=false) {
@@ -51,6 +54,9 @@ namespace {
 		c.testDuration = getInt("testDuration", 30'000'000);
 		SPDLOG_INFO("testDuration: {}", c.testDuration);
 
+		if (const char* out = getenv("profileOut")) c.outputPrefix = out;
+		if (!c.outputPrefix.empty()) SPDLOG_INFO("profileOut: {}", c.outputPrefix);
+
 		c.valid = true;
 
 		return c;
@@ -0,0 +1,519 @@
+#include "babus/client.h"
+#include "babus/domain.h"
+#include "babus/waiter.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <mqueue.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "babus/benchmark/histogram.hpp"
+#include "babus/benchmark/profileCfg.hpp"
+
+//
+// babus against the local IPC mechanisms it replaces, on the same one-producer / N-consumer workload, with
+// every consumer in its own forked process:
+//
+//      pipe        one pipe per consumer
+//      uds-stream  one AF_UNIX SOCK_STREAM socketpair per consumer
+//      uds-dgram   one AF_UNIX SOCK_DGRAM socketpair per consumer (messages must fit the socket buffer)
+//      mq          one POSIX message queue per consumer (messages must fit `fs/mqueue/msgsize_max`)
+//      memfd       a sealed memfd per message, its fd passed to every consumer with SCM_RIGHTS
+//      babus       one slot, read with a `Waiter`
+//
+// Latency is from just before the producer starts sending until a consumer has its own copy of the message.
+// Socket-like transports send one copy per consumer, so their latency grows with fan-out.
+//
+// The default cases are the two message types of `profileBabus.cc` (128 B at `imuRate`, `imageSize` at 30 Hz),
+// each with 1 and 5 consumers. Each case runs for `testDuration` micros. Override with environment variables:
+//
+//      ipcSizes=64,4096,262144 ipcRate=1000   message sizes, all published at `ipcRate` (default `imuRate`)
+//      ipcFanouts=1,2,4,8                     consumer counts
+//      ipcTransports=pipe,babus               a subset of transports
+//      profileOut=ipc                         also write ipc.csv / ipc.json
+//
+// Transports that cannot carry a message size are reported as n/a.
+//
+
+using namespace babus;
+
+namespace {
+
+    ProfileConfig g_cfg;
+
+    constexpr std::size_t MinMsgSize = 16; // Timestamp at [0,8), counter at [8,16).
+    constexpr uint64_t StopCounter   = ~uint64_t(0);
+
+    struct Case {
+        std::size_t size;
+        int rate;
+        int fanout;
+
+        inline std::string name() const {
+            return fmt::format("size={} fanout={}", size, fanout);
+        }
+    };
+
+    std::vector<int64_t> getIntList(const char* key, std::vector<int64_t> def) {
+        const char* val = getenv(key);
+        if (val == nullptr) return def;
+        std::vector<int64_t> out;
+        std::stringstream ss(val);
+        for (std::string item; std::getline(ss, item, ',');)
+            if (!item.empty()) out.push_back(std::stoll(item));
+        return out;
+    }
+
+    // -----------------------------------------------------
+    // Transports
+    //
+    // Each has the same shape, and `runCase` is templated on it:
+    //      setup(c)          in the parent, before forking. False if it cannot carry `c.size`.
+    //      openConsumer(i)   in consumer i, after forking.
+    //      openProducer()    in the parent, after forking.
+    //      send(msg, n)      deliver one message to every consumer.
+    //      receive(buf)      copy the next message into `buf`. False on error.
+    //      teardown()        in the parent, after the consumers exited.
+    // -----------------------------------------------------
+
+    enum class FdKind { Pipe, UdsStream, UdsDgram };
+
+    struct FdTransport {
+        FdKind kind;
+        std::size_t size = 0;
+        std::vector<std::array<int, 2>> fds; // [0] is read by the consumer, [1] written by the producer.
+        int myFd = -1;
+
+        inline FdTransport(FdKind kind)
+            : kind(kind) {
+        }
+
+        inline const char* name() const {
+            return kind == FdKind::Pipe ? "pipe" : kind == FdKind::UdsStream ? "uds-stream" : "uds-dgram";
+        }
+
+        inline bool setup(const Case& c) {
+            size = c.size;
+            for (int i = 0; i < c.fanout; i++) {
+                int p[2];
+                int stat = kind == FdKind::Pipe ? pipe(p) : socketpair(AF_UNIX, kind == FdKind::UdsStream ? SOCK_STREAM : SOCK_DGRAM, 0, p);
+                if (stat != 0) throw std::runtime_error(fmt::format("{}: could not create channel: {}", name(), strerror(errno)));
+                fds.push_back({ p[0], p[1] });
+
+                if (kind == FdKind::UdsDgram) {
+                    // A datagram must fit the send buffer whole. Ask for enough, and probe what we got.
+                    int buf = int(std::min<std::size_t>(size * 2 + 4096, 1 << 30));
+                    setsockopt(p[1], SOL_SOCKET, SO_SNDBUF, &buf, sizeof(buf));
+                    setsockopt(p[0], SOL_SOCKET, SO_RCVBUF, &buf, sizeof(buf));
+                    if (i == 0 and !probeDatagram(p)) {
+                        close(p[0]);
+                        close(p[1]);
+                        fds.clear();
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        inline bool probeDatagram(int p[2]) {
+            std::vector<uint8_t> msg(size);
+            if (::send(p[1], msg.data(), size, MSG_DONTWAIT) != ssize_t(size)) return false;
+            return recv(p[0], msg.data(), size, 0) == ssize_t(size);
+        }
+
+        inline void openConsumer(int i) {
+            for (int j = 0; j < int(fds.size()); j++) {
+                close(fds[j][1]);
+                if (j != i) close(fds[j][0]);
+            }
+            myFd = fds[i][0];
+        }
+        inline void openProducer() {
+            for (auto& p : fds) close(p[0]);
+        }
+
+        inline void send(const uint8_t* msg, std::size_t n) {
+            for (auto& p : fds) {
+                bool ok = kind == FdKind::UdsDgram ? ::send(p[1], msg, n, 0) == ssize_t(n) : writeFull(p[1], msg, n);
+                if (!ok) SPDLOG_ERROR("{}: send failed: {}", name(), strerror(errno));
+            }
+        }
+
+        inline bool receive(std::vector<uint8_t>& buf) {
+            if (kind == FdKind::UdsDgram) return recv(myFd, buf.data(), size, 0) == ssize_t(size);
+            return readFull(myFd, buf.data(), size);
+        }
+
+        inline void teardown() {
+            for (auto& p : fds) close(p[1]);
+            fds.clear();
+        }
+    };
+
+    struct MqTransport {
+        std::size_t size = 0;
+        std::vector<mqd_t> queues;
+        mqd_t myQueue = -1;
+
+        inline const char* name() const {
+            return "mq";
+        }
+
+        static inline std::string queueName(int i) {
+            return fmt::format("/babusIpcBench{}", i);
+        }
+
+        inline bool setup(const Case& c) {
+            size = c.size;
+            for (int i = 0; i < c.fanout; i++) {
+                mq_attr attr {};
+                attr.mq_maxmsg  = 10; // The default `fs/mqueue/msg_max`.
+                attr.mq_msgsize = long(size);
+                mq_unlink(queueName(i).c_str());
+                mqd_t q = mq_open(queueName(i).c_str(), O_CREAT | O_RDWR, 0600, &attr);
+                if (q == mqd_t(-1)) {
+                    if (errno == EINVAL) {
+                        teardown();
+                        return false;
+                    }
+                    throw std::runtime_error(fmt::format("mq: could not open queue: {}", strerror(errno)));
+                }
+                queues.push_back(q);
+            }
+            return true;
+        }
+
+        inline void openConsumer(int i) {
+            myQueue = queues[i];
+        }
+        inline void openProducer() {
+        }
+
+        inline void send(const uint8_t* msg, std::size_t n) {
+            for (mqd_t q : queues)
+                if (mq_send(q, (const char*)msg, n, 0) != 0) SPDLOG_ERROR("mq: send failed: {}", strerror(errno));
+        }
+
+        inline bool receive(std::vector<uint8_t>& buf) {
+            return mq_receive(myQueue, (char*)buf.data(), size, nullptr) == ssize_t(size);
+        }
+
+        inline void teardown() {
+            for (std::size_t i = 0; i < queues.size(); i++) {
+                mq_close(queues[i]);
+                mq_unlink(queueName(i).c_str());
+            }
+            queues.clear();
+        }
+    };
+
+    struct MemfdTransport {
+        FdTransport channels { FdKind::UdsDgram };
+        std::size_t size = 0;
+
+        inline const char* name() const {
+            return "memfd";
+        }
+
+        inline bool setup(const Case& c) {
+            size = c.size;
+            Case small { 1, c.rate, c.fanout };
+            return channels.setup(small);
+        }
+
+        inline void openConsumer(int i) {
+            channels.openConsumer(i);
+        }
+        inline void openProducer() {
+            channels.openProducer();
+        }
+
+        inline void send(const uint8_t* msg, std::size_t n) {
+            int fd = memfd_create("babusIpcBench", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+            if (fd < 0 or !writeFull(fd, msg, n) or fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE) != 0) {
+                SPDLOG_ERROR("memfd: could not create message: {}", strerror(errno));
+                if (fd >= 0) close(fd);
+                return;
+            }
+            for (auto& p : channels.fds) sendFd(p[1], fd);
+            close(fd);
+        }
+
+        static inline void sendFd(int sock, int fd) {
+            char byte = 0;
+            iovec iov { &byte, 1 };
+            alignas(cmsghdr) char ctrl[CMSG_SPACE(sizeof(int))] = {};
+            msghdr msg {};
+            msg.msg_iov              = &iov;
+            msg.msg_iovlen           = 1;
+            msg.msg_control          = ctrl;
+            msg.msg_controllen       = sizeof(ctrl);
+            cmsghdr* cmsg            = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level         = SOL_SOCKET;
+            cmsg->cmsg_type          = SCM_RIGHTS;
+            cmsg->cmsg_len           = CMSG_LEN(sizeof(int));
+            memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+            if (sendmsg(sock, &msg, 0) != 1) SPDLOG_ERROR("memfd: sendmsg failed: {}", strerror(errno));
+        }
+
+        inline bool receive(std::vector<uint8_t>& buf) {
+            char byte;
+            iovec iov { &byte, 1 };
+            alignas(cmsghdr) char ctrl[CMSG_SPACE(sizeof(int))];
+            msghdr msg {};
+            msg.msg_iov        = &iov;
+            msg.msg_iovlen     = 1;
+            msg.msg_control    = ctrl;
+            msg.msg_controllen = sizeof(ctrl);
+            if (recvmsg(channels.myFd, &msg, MSG_CMSG_CLOEXEC) != 1) return false;
+            cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+            if (cmsg == nullptr or cmsg->cmsg_type != SCM_RIGHTS) return false;
+            int fd;
+            memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+
+            void* ptr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+            if (ptr == MAP_FAILED) return false;
+            memcpy(buf.data(), ptr, size);
+            munmap(ptr, size);
+            return true;
+        }
+
+        inline void teardown() {
+            channels.teardown();
+        }
+    };
+
+    struct BabusTransport {
+        static constexpr const char* DomainName = "ipcBenchDomain";
+        static constexpr const char* SlotName   = "ipcBench";
+
+        std::size_t size = 0;
+        std::unique_ptr<ClientDomain> domain;
+        ClientSlot* slot = nullptr;
+        std::unique_ptr<Waiter> waiter;
+
+        inline const char* name() const {
+            return "babus";
+        }
+
+        inline bool setup(const Case& c) {
+            size = c.size;
+            if (size > SlotDataCapacity) return false;
+            ClientDomain dom = ClientDomain::openOrCreate(DomainName);
+            dom.getSlot(SlotName);
+            return true;
+        }
+
+        inline void open() {
+            domain.reset(new ClientDomain(ClientDomain::openOrCreate(DomainName)));
+            slot = &domain->getSlot(SlotName);
+        }
+        inline void openConsumer(int) {
+            open();
+            waiter = std::make_unique<Waiter>(domain->ptr());
+            waiter->subscribeTo(slot->ptr());
+        }
+        inline void openProducer() {
+            open();
+        }
+
+        inline void send(const uint8_t* msg, std::size_t n) {
+            slot->write({ (void*)msg, n });
+        }
+
+        inline bool receive(std::vector<uint8_t>& buf) {
+            while (true) {
+                // Sample before visiting, so a write in between makes the wait return.
+                uint32_t prv = domain->ptr()->seq.load();
+                uint32_t n   = waiter->forEachNewSlot([&](LockedView&& view) { memcpy(buf.data(), view.span.ptr, std::min(size, view.span.len)); });
+                if (n > 0) return true;
+                domain->ptr()->seq.waitForChange(prv, waiter->wakeMask());
+            }
+        }
+
+        inline void teardown() {
+            slot = nullptr;
+            domain.reset();
+            unlink((std::string { Prefix } + SlotName).c_str());
+            unlink((std::string { Prefix } + DomainName).c_str());
+        }
+    };
+
+    // -----------------------------------------------------
+    // One case
+    // -----------------------------------------------------
+
+    template <class T> [[noreturn]] void runConsumer(T& t, const Case& c, int i, int readyFd, int resultFd) {
+        t.openConsumer(i);
+        std::vector<uint8_t> buf(c.size);
+        LatencyHistogram latency;
+        uint64_t expected = 0, missed = 0;
+
+        char ready = 1;
+        writeFull(readyFd, &ready, 1);
+        close(readyFd);
+
+        int64_t start = nowNanos();
+        while (t.receive(buf)) {
+            int64_t now      = nowNanos();
+            uint64_t counter = reinterpret_cast<const uint64_t*>(buf.data())[1];
+            if (counter == StopCounter) break;
+            latency.record(now - reinterpret_cast<const int64_t*>(buf.data())[0]);
+            if (counter > expected) missed += counter - expected;
+            expected = counter + 1;
+        }
+
+        sendRow(resultFd, { "consumer", c.name(), "receive", latency, missed, (nowNanos() - start) / 1e9 });
+        close(resultFd);
+        _exit(0);
+    }
+
+    // Returns false if the transport cannot carry this case.
+    template <class T> bool runCase(T t, const Case& c, ProfileResults& results, std::vector<ProfileResults::Row>& merged) {
+        if (!t.setup(c)) {
+            SPDLOG_INFO("{:>10} {:>28} : n/a", t.name(), c.name());
+            return false;
+        }
+
+        int readyPipe[2];
+        if (pipe(readyPipe) != 0) throw std::runtime_error("pipe() failed");
+        std::vector<std::pair<pid_t, int>> children;
+        for (int i = 0; i < c.fanout; i++) {
+            int resultPipe[2];
+            if (pipe(resultPipe) != 0) throw std::runtime_error("pipe() failed");
+            fflush(nullptr);
+            pid_t pid = fork();
+            if (pid < 0) throw std::runtime_error("fork() failed");
+            if (pid == 0) {
+                close(readyPipe[0]);
+                close(resultPipe[0]);
+                for (auto& ch : children) close(ch.second);
+                runConsumer(t, c, i, readyPipe[1], resultPipe[1]);
+            }
+            close(resultPipe[1]);
+            children.emplace_back(pid, resultPipe[0]);
+        }
+        close(readyPipe[1]);
+        for (int i = 0; i < c.fanout; i++) {
+            char ready;
+            readFull(readyPipe[0], &ready, 1);
+        }
+        close(readyPipe[0]);
+
+        t.openProducer();
+        std::vector<uint8_t> msg(c.size);
+        for (std::size_t i = MinMsgSize; i < msg.size(); i++) msg[i] = i % 256;
+        LatencyHistogram sendLatency;
+        const int64_t period = c.rate > 0 ? 1'000'000'000 / c.rate : 0;
+        const int64_t start = nowNanos(), stop = start + g_cfg.testDuration * 1000;
+        int64_t next        = start;
+
+        for (uint64_t counter = 0; nowNanos() < stop; counter++) {
+            if (period > 0) {
+                next += period;
+                int64_t now = nowNanos();
+                if (next > now) usleep((next - now) / 1000);
+            }
+            reinterpret_cast<uint64_t*>(msg.data())[1] = counter;
+            int64_t startOfSend                        = nowNanos();
+            reinterpret_cast<int64_t*>(msg.data())[0]  = startOfSend;
+            t.send(msg.data(), msg.size());
+            sendLatency.record(nowNanos() - startOfSend);
+        }
+        double seconds                             = (nowNanos() - start) / 1e9;
+        reinterpret_cast<uint64_t*>(msg.data())[1] = StopCounter;
+        t.send(msg.data(), msg.size());
+
+        ProfileResults::Row send { "producer", c.name(), "send", sendLatency, 0, seconds, t.name() };
+        ProfileResults::Row all { "consumer", c.name(), "receive", {}, 0, 0, t.name() };
+        results.add(send);
+        for (auto& ch : children) {
+            for (ProfileResults::Row row; recvRow(ch.second, row);) {
+                row.transport = t.name();
+                results.add(row);
+                all.hist.merge(row.hist);
+                all.missed += row.missed;
+                all.seconds = std::max(all.seconds, row.seconds);
+            }
+            close(ch.second);
+            int wstatus = 0;
+            waitpid(ch.first, &wstatus, 0);
+            if (!WIFEXITED(wstatus) or WEXITSTATUS(wstatus) != 0) SPDLOG_ERROR("{}: consumer pid {} failed", t.name(), ch.first);
+        }
+        t.teardown();
+
+        SPDLOG_INFO("{:>10} {:>28} : send    {}", t.name(), c.name(), sendLatency.summary());
+        SPDLOG_INFO("{:>10} {:>28} : receive {} (missed {})", t.name(), c.name(), all.hist.summary(), all.missed);
+        merged.push_back(all);
+        return true;
+    }
+
+}
+
+int main() {
+    g_cfg = getConfig();
+    assert(g_cfg.valid);
+
+    std::vector<Case> cases;
+    std::vector<int64_t> fanouts = getIntList("ipcFanouts", { 1, 5 });
+    if (getenv("ipcSizes") == nullptr) {
+        for (auto f : fanouts) cases.push_back(Case { 128, g_cfg.imuRate, int(f) });
+        for (auto f : fanouts) cases.push_back(Case { g_cfg.imageSize, 30, int(f) });
+    } else {
+        int rate = getInt("ipcRate", g_cfg.imuRate);
+        for (auto s : getIntList("ipcSizes", {}))
+            for (auto f : fanouts) cases.push_back(Case { std::size_t(s), rate, int(f) });
+    }
+    for (const auto& c : cases) {
+        if (c.size < MinMsgSize or c.fanout < 1) {
+            SPDLOG_ERROR("bad case '{}': sizes must be at least {} and fan-outs at least 1", c.name(), MinMsgSize);
+            return 1;
+        }
+    }
+
+    const char* transportsEnv = getenv("ipcTransports");
+    std::string transports    = transportsEnv ? transportsEnv : "pipe,uds-stream,uds-dgram,mq,memfd,babus";
+    auto enabled              = [&](const std::string& t) { return ("," + transports + ",").find("," + t + ",") != std::string::npos; };
+
+    ProfileResults results;
+    // Merged consumer rows per case, for the side-by-side table.
+    std::map<std::pair<std::size_t, int>, std::vector<ProfileResults::Row>> byCase;
+    for (const auto& c : cases) {
+        auto& merged = byCase[{ c.size, c.fanout }];
+        if (enabled("pipe")) runCase(FdTransport { FdKind::Pipe }, c, results, merged);
+        if (enabled("uds-stream")) runCase(FdTransport { FdKind::UdsStream }, c, results, merged);
+        if (enabled("uds-dgram")) runCase(FdTransport { FdKind::UdsDgram }, c, results, merged);
+        if (enabled("mq")) runCase(MqTransport {}, c, results, merged);
+        if (enabled("memfd")) runCase(MemfdTransport {}, c, results, merged);
+        if (enabled("babus")) runCase(BabusTransport {}, c, results, merged);
+    }
+
+    SPDLOG_INFO("");
+    SPDLOG_INFO("receive latency p50 / p99, fastest p50 first:");
+    for (auto& kv : byCase) {
+        auto& rows = kv.second;
+        std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) { return a.hist.percentile(.5) < b.hist.percentile(.5); });
+        std::string line;
+        for (const auto& r : rows)
+            line += fmt::format("  {} {}/{}", r.transport, fmtDuration(r.hist.percentile(.5)), fmtDuration(r.hist.percentile(.99)));
+        SPDLOG_INFO("{:>28} :{}", Case { kv.first.first, 0, kv.first.second }.name(), line);
+    }
+
+    if (!g_cfg.outputPrefix.empty()) results.write(g_cfg.outputPrefix, "");
+    return 0;
+}
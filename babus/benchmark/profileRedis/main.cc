@@ -4,8 +4,13 @@
 
 #include <chrono>
 #include <cassert>
+#include <memory>
+#include <thread>
 #include <unistd.h>
+#include <unordered_map>
+#include <vector>
 
+#include "babus/benchmark/histogram.hpp"
 #include "babus/benchmark/profileCfg.hpp"
 
 using namespace sw::redis;
@@ -14,40 +19,32 @@ using namespace sw::redis;
 
 namespace {
 	ProfileConfig g_cfg;
+	ProfileResults g_results;
 
     volatile bool _doStop              = false;
 
-    int64_t getMicros() {
-        using namespace std::chrono;
-        auto tp = high_resolution_clock::now();
-        return duration_cast<microseconds>(tp.time_since_epoch()).count();
-    }
-
-    inline std::string fmtDuration(double micros) {
-        if (micros > 1'000'000)
-            return fmt::format("{:>5.1f} s", micros / 1e6);
-        else if (micros > 1'000)
-            return fmt::format("{:>5.1f}ms", micros / 1e3);
-        else
-            return fmt::format("{:>5.1f}us", micros);
-    }
-
     using MessageBuffer = std::vector<uint8_t>;
 
-    inline std::string allocMessage(std::size_t len) {
-        assert(len > sizeof(int64_t));
+    // Layout: [creation time (int64 ns)] [producer's message counter (uint64)] [pattern...].
+    // Redis streams have no sequence number we can check for gaps, so the counter lets consumers count missed messages.
+    inline std::string allocMessage(std::size_t len, uint64_t counter = 0) {
+        assert(len >= 2 * sizeof(int64_t));
 		std::string out;
 		out.resize(len);
-        for (std::size_t i = sizeof(int64_t); i < len; i++) out[i] = (i % 256);
-        reinterpret_cast<int64_t*>(out.data())[0] = getMicros();
+        for (std::size_t i = 2 * sizeof(int64_t); i < len; i++) out[i] = (i % 256);
+        reinterpret_cast<int64_t*>(out.data())[0]  = nowNanos();
+        reinterpret_cast<uint64_t*>(out.data())[1] = counter;
         return out;
     }
+    inline uint64_t getMessageCounter(const char* buf) {
+        return reinterpret_cast<const uint64_t*>(buf)[1];
+    }
 
     inline int64_t getDuration(int64_t then) {
-        return getMicros() - then;
+        return nowNanos() - then;
     }
     inline int64_t getElapsedFromMessageCreation(const uint8_t* buf) {
-        int64_t now  = getMicros();
+        int64_t now  = nowNanos();
         int64_t then = reinterpret_cast<const int64_t*>(buf)[0];
         // SPDLOG_INFO("now {} then {} diff {}", now, then, now-then);
         return now - then;
@@ -87,10 +84,7 @@ namespace {
 		Redis redis;
         std::thread thread;
 
-        struct {
-            int64_t writeLatency = 0;
-            int64_t n            = 0;
-        } sum;
+        LatencyHistogram writeLatency;
 
         inline Producer(std::string name, std::string slotName, int frequency, std::size_t msgSize)
             : name(name)
@@ -125,8 +119,8 @@ namespace {
             // SPDLOG_TRACE("Producer '{}' dtor, waiting for join", name);
             thread.join();
             // SPDLOG_TRACE("Producer '{}' dtor, waiting for join ... done", name);
-            SPDLOG_INFO("Producer '{:>40}' avg latency of write       : {} (n {:>12L})", name,
-                        fmtDuration(static_cast<double>(sum.writeLatency) / sum.n), sum.n);
+            SPDLOG_INFO("Producer '{:>40}' latency of write       : {}", name, writeLatency.summary());
+            g_results.add("producer", name, "write", writeLatency);
         }
 
         inline void loop() {
@@ -137,8 +131,8 @@ namespace {
             while (!_doStop) {
                 usleep(sleepTime);
 
-                auto msg             = allocMessage(msgSize);
-                int64_t startOfWrite = getMicros();
+                auto msg             = allocMessage(msgSize, writeLatency.n + 1);
+                int64_t startOfWrite = nowNanos();
 
                 // clientSlot.write({ msg.data(), msg.size() });
 				using Attrs = std::vector<std::pair<std::string, std::string>>;
@@ -148,8 +142,7 @@ namespace {
 				redis.xadd(slotName, "*", attrs.begin(), attrs.end());
 				redis.xtrim(slotName, 1); // TODO: Pipeline
 
-                sum.writeLatency += getDuration(startOfWrite);
-                sum.n++;
+                writeLatency.record(getDuration(startOfWrite));
             }
         }
     };
@@ -161,11 +154,8 @@ namespace {
 		Redis redis;
         std::thread thread;
 
-        struct {
-            // int64_t viewLatency = 0;
-            int64_t copyLatency = 0;
-            int64_t n           = 0;
-        } sum;
+        LatencyHistogram copyLatency;
+        uint64_t missed = 0; // Messages trimmed away before we read them.
 
         inline Consumer(std::string name, const std::vector<std::string>& slotNames, int sleepTime = 0)
             : name(name)
@@ -190,9 +180,8 @@ namespace {
             thread.join();
             // SPDLOG_TRACE("Consumer '{}' dtor, waiting for join ... done", name);
 
-            // SPDLOG_INFO("Consumer '{:>40}' avg latency of view        : {} (n {:>12L})", name, fmtDuration(static_cast<double>(sum.viewLatency) / sum.n), sum.n);
-            SPDLOG_INFO("Consumer '{:>40}' avg latency of view + copy : {} (n {:>12L})", name,
-                        fmtDuration(static_cast<double>(sum.copyLatency) / sum.n), sum.n);
+            SPDLOG_INFO("Consumer '{:>40}' latency of view + copy : {} (missed {})", name, copyLatency.summary(), missed);
+            g_results.add("consumer", name, "view+copy", copyLatency, missed);
         }
 
         inline void loop() {
@@ -210,6 +199,8 @@ namespace {
 				throw std::runtime_error("invalid key");
 			};
 
+			std::unordered_map<std::string, uint64_t> lastCounters;
+
 			for (const auto& slotName : slotNames) {
 				keysAndIds.push_back({slotName, "0-0"});
 				// SPDLOG_INFO("consumer '{}' listening to key '{}'", name, slotName);
@@ -235,9 +226,12 @@ namespace {
 
 						// sum.viewLatency += getElapsedFromMessageCreation((const uint8_t*)view.span.ptr);
 						auto elapsed = getElapsedFromMessageCreation((const uint8_t*)value.data());
-						// if (elapsed > 1e6) SPDLOG_INFO("warning, long delay: {}s (slot {}) (n {})", elapsed * 1e-6, key, sum.n);
-						sum.copyLatency += elapsed;
-						sum.n++;
+						copyLatency.record(elapsed);
+
+						uint64_t counter = getMessageCounter(value.data());
+						auto it          = lastCounters.find(key);
+						if (it != lastCounters.end() and counter > it->second + 1) missed += counter - it->second - 1;
+						lastCounters[key] = counter;
 
 						// SPDLOG_INFO("set key '{}' id from '{}' to '{}' duration {}", key, lookupKeyRef(key).second, id, getElapsedFromMessageCreation((const uint8_t*)value.data()));
 						lookupKeyRef(key).second = id;
@@ -298,11 +292,11 @@ namespace {
             SPDLOG_DEBUG("sleeping for {:.1f} seconds ... done", duration / 1e6);
             _doStop   = true;
 
-            auto stop = allocMessage(8 + 4);
-            stop[8]   = (uint8_t)'s';
-            stop[9]   = (uint8_t)'t';
-            stop[10]  = (uint8_t)'o';
-            stop[11]  = (uint8_t)'p';
+            auto stop = allocMessage(16 + 4);
+            stop[16]  = (uint8_t)'s';
+            stop[17]  = (uint8_t)'t';
+            stop[18]  = (uint8_t)'o';
+            stop[19]  = (uint8_t)'p';
         }
     };
 
@@ -317,10 +311,11 @@ int main() {
 	assert(g_cfg.valid);
 	SPDLOG_INFO("redis using tcp: {}", g_cfg.redis.useTcp);
 
-	static constexpr int64_t testDuration = 30'000'000;
-    App app(false);
-	app.run(testDuration);
-
+    {
+        App app(false);
+        app.run(g_cfg.testDuration);
+    }
+    if (!g_cfg.outputPrefix.empty()) g_results.write(g_cfg.outputPrefix, g_cfg.redis.useTcp ? "redis-tcp" : "redis-uds");
 
 	return 0;
 }
@@ -0,0 +1,435 @@
+#include "babus/client.h"
+#include "babus/domain.h"
+#include "babus/waiter.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "babus/benchmark/histogram.hpp"
+
+//
+// Multi-process benchmark driven by a topology file.
+//
+//      runProfileTopology <topology file> [durationMs]
+//
+// Every producer and consumer is a forked process with its own mapping of the domain and slots, optionally
+// pinned to a CPU and running under a given scheduler policy. Children report their histograms back over a
+// pipe and the parent merges them, logs a summary, and writes `<profileOut>.csv/json` if `profileOut` is set.
+//
+// The file has one directive per line; `#` starts a comment:
+//
+//      domain   topoBench                  # Domain name (default "topoBench").
+//      duration 10000                      # Milliseconds.
+//      mapping  distinct                   # Each process maps the domain at a different address (default),
+//      mapping  fixed 0x600000000000       # or all map it at the same address (`targetAddr`).
+//      slot     imu   size 128     rate 1000
+//      slot     image size 6220800 rate 30 # `rate 0` publishes as fast as possible.
+//      producer imu cpu 0 sched fifo prio 50
+//      consumer imu,image count 4 cpu 1-3 sched other name fusion
+//
+// `producer` and `consumer` accept `count <n>`, `cpu <a>[-<b>]` (instance i is pinned to the i'th cpu of the
+// range, wrapping), `sched other|batch|idle|fifo|rr`, `prio <n>` and `name <s>`. A slot with no `producer`
+// line gets one unpinned producer. Realtime policies need CAP_SYS_NICE; without it a warning is logged
+// and the process keeps the default policy.
+//
+// See `scripts/sweepTopology.sh` for sweeps over reader fan-out and message size.
+//
+
+using namespace babus;
+
+namespace {
+
+    constexpr const char* ControlSlot = "topoControl";
+    constexpr std::size_t MinMsgSize  = 16; // Timestamp at [0,8), producer counter at [8,16).
+
+    struct ProcessSpec {
+        std::string role; // producer / consumer
+        std::string name;
+        std::vector<std::string> slots;
+        int count = 1;
+        std::vector<int> cpus;
+        int policy   = SCHED_OTHER;
+        int priority = 0;
+    };
+
+    struct SlotSpec {
+        std::string name;
+        std::size_t size = 128;
+        int rate         = 100;
+    };
+
+    struct Topology {
+        std::string domain  = "topoBench";
+        int64_t durationMs  = 10'000;
+        void* targetAddr    = nullptr;
+        std::vector<SlotSpec> slots;
+        std::vector<ProcessSpec> processes;
+
+        inline const SlotSpec* findSlot(const std::string& name) const {
+            for (const auto& s : slots)
+                if (s.name == name) return &s;
+            return nullptr;
+        }
+    };
+
+    std::vector<std::string> split(const std::string& s, char sep) {
+        std::vector<std::string> out;
+        std::stringstream ss(s);
+        std::string item;
+        while (std::getline(ss, item, sep))
+            if (!item.empty()) out.push_back(item);
+        return out;
+    }
+
+    int parsePolicy(const std::string& s) {
+        if (s == "other") return SCHED_OTHER;
+        if (s == "batch") return SCHED_BATCH;
+        if (s == "idle") return SCHED_IDLE;
+        if (s == "fifo") return SCHED_FIFO;
+        if (s == "rr") return SCHED_RR;
+        throw std::runtime_error("unknown scheduler policy '" + s + "'");
+    }
+
+    std::vector<int> parseCpus(const std::string& s) {
+        std::vector<int> out;
+        for (const auto& part : split(s, ',')) {
+            int a, b;
+            int n = sscanf(part.c_str(), "%d-%d", &a, &b);
+            if (n < 1) throw std::runtime_error("bad cpu list '" + s + "'");
+            if (n == 1) b = a;
+            for (int c = a; c <= b; c++) out.push_back(c);
+        }
+        return out;
+    }
+
+    Topology parseTopology(const std::string& path) {
+        std::ifstream ifs(path);
+        if (!ifs.good()) {
+            SPDLOG_ERROR("could not open topology file '{}'", path);
+            throw std::runtime_error("could not open topology file");
+        }
+
+        Topology t;
+        std::string line;
+        for (int lineNo = 1; std::getline(ifs, line); lineNo++) {
+            line = line.substr(0, line.find('#'));
+            std::istringstream ls(line);
+            std::vector<std::string> tok;
+            for (std::string w; ls >> w;) tok.push_back(w);
+            if (tok.empty()) continue;
+
+            auto fail = [&](const std::string& why) {
+                SPDLOG_ERROR("{}:{}: {}", path, lineNo, why);
+                throw std::runtime_error("bad topology file");
+            };
+            if (tok.size() < 2) fail("missing argument to '" + tok[0] + "'");
+
+            if (tok[0] == "domain") {
+                t.domain = tok[1];
+            } else if (tok[0] == "duration") {
+                t.durationMs = std::stoll(tok[1]);
+            } else if (tok[0] == "mapping") {
+                if (tok[1] == "distinct") t.targetAddr = nullptr;
+                else if (tok[1] == "fixed" and tok.size() == 3) t.targetAddr = (void*)std::stoull(tok[2], nullptr, 0);
+                else fail("mapping is 'distinct' or 'fixed <addr>'");
+            } else if (tok[0] == "slot") {
+                SlotSpec s;
+                s.name = tok[1];
+                if (s.name.size() >= MaxNameLength) fail("slot name too long");
+                for (std::size_t i = 2; i + 1 < tok.size(); i += 2) {
+                    if (tok[i] == "size") s.size = std::stoull(tok[i + 1]);
+                    else if (tok[i] == "rate") s.rate = std::stoi(tok[i + 1]);
+                    else fail("unknown slot key '" + tok[i] + "'");
+                }
+                if (s.size < MinMsgSize or s.size > SlotDataCapacity) fail(fmt::format("slot size must be in [{}, {}]", MinMsgSize, SlotDataCapacity));
+                t.slots.push_back(s);
+            } else if (tok[0] == "producer" or tok[0] == "consumer") {
+                ProcessSpec p;
+                p.role  = tok[0];
+                p.slots = split(tok[1], ',');
+                for (std::size_t i = 2; i + 1 < tok.size(); i += 2) {
+                    if (tok[i] == "count") p.count = std::stoi(tok[i + 1]);
+                    else if (tok[i] == "cpu") p.cpus = parseCpus(tok[i + 1]);
+                    else if (tok[i] == "sched") p.policy = parsePolicy(tok[i + 1]);
+                    else if (tok[i] == "prio") p.priority = std::stoi(tok[i + 1]);
+                    else if (tok[i] == "name") p.name = tok[i + 1];
+                    else fail("unknown " + p.role + " key '" + tok[i] + "'");
+                }
+                if (p.role == "producer" and p.slots.size() != 1) fail("a producer writes exactly one slot");
+                if (p.name.empty()) p.name = p.role == "producer" ? p.slots[0] + " =>" : "=> " + tok[1];
+                t.processes.push_back(p);
+            } else {
+                fail("unknown directive '" + tok[0] + "'");
+            }
+        }
+
+        for (const auto& p : t.processes)
+            for (const auto& s : p.slots)
+                if (t.findSlot(s) == nullptr) throw std::runtime_error("'" + p.name + "' uses undeclared slot '" + s + "'");
+        for (const auto& s : t.slots) {
+            bool hasProducer = false;
+            for (const auto& p : t.processes) hasProducer |= p.role == "producer" and p.slots[0] == s.name;
+            if (!hasProducer) {
+                ProcessSpec p;
+                p.role  = "producer";
+                p.name  = s.name + " =>";
+                p.slots = { s.name };
+                t.processes.push_back(p);
+            }
+        }
+        return t;
+    }
+
+    // -----------------------------------------------------
+    // Children
+    // -----------------------------------------------------
+
+    struct ChildContext {
+        const Topology& topo;
+        const ProcessSpec& spec;
+        int instance;
+        int goFd;
+        int resultFd;
+    };
+
+    void applyPlacement(const ProcessSpec& spec, int instance) {
+        if (!spec.cpus.empty()) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(spec.cpus[instance % spec.cpus.size()], &set);
+            if (sched_setaffinity(0, sizeof(set), &set) != 0) SPDLOG_WARN("'{}' could not pin to cpu: {}", spec.name, strerror(errno));
+        }
+        if (spec.policy != SCHED_OTHER or spec.priority != 0) {
+            sched_param param {};
+            param.sched_priority = spec.priority;
+            if (sched_setscheduler(0, spec.policy, &param) != 0)
+                SPDLOG_WARN("'{}' could not set scheduler policy {} prio {}: {}", spec.name, spec.policy, spec.priority, strerror(errno));
+        }
+    }
+
+    // With `mapping distinct`, shift where the kernel places this process's mappings so that no two
+    // processes see the domain at the same address (forked children would otherwise all get the same one).
+    void shiftMappings(const Topology& topo, int processIndex) {
+        if (topo.targetAddr != nullptr) return;
+        std::size_t len = std::size_t(processIndex + 1) * (2 << 20);
+        if (mmap(nullptr, len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0) == MAP_FAILED)
+            SPDLOG_WARN("could not reserve {} bytes to shift mappings", len);
+    }
+
+    // Block until the parent closes the write end of the go pipe: that releases every child at once.
+    void waitForGo(int goFd) {
+        char c;
+        while (::read(goFd, &c, 1) < 0 and errno == EINTR) { }
+    }
+
+    void runProducer(ChildContext& ctx, ClientDomain& domain) {
+        const SlotSpec& slotSpec = *ctx.topo.findSlot(ctx.spec.slots[0]);
+        ClientSlot& slot         = domain.getSlot(slotSpec.name.c_str());
+        std::vector<uint8_t> msg(slotSpec.size);
+        for (std::size_t i = MinMsgSize; i < msg.size(); i++) msg[i] = i % 256;
+
+        LatencyHistogram writeLatency;
+        const int64_t period = slotSpec.rate > 0 ? 1'000'000'000 / slotSpec.rate : 0;
+
+        waitForGo(ctx.goFd);
+        const int64_t start = nowNanos(), stop = start + ctx.topo.durationMs * 1'000'000;
+        int64_t next        = start;
+        uint64_t counter    = 0;
+
+        for (int64_t now = start; now < stop; now = nowNanos()) {
+            if (period > 0) {
+                next += period;
+                if (next > now) usleep((next - now) / 1000);
+            }
+            reinterpret_cast<uint64_t*>(msg.data())[1] = counter++;
+            int64_t startOfWrite                       = nowNanos();
+            reinterpret_cast<int64_t*>(msg.data())[0]  = startOfWrite;
+            slot.write({ msg.data(), msg.size() });
+            writeLatency.record(nowNanos() - startOfWrite);
+        }
+
+        double seconds = (nowNanos() - start) / 1e9;
+        sendRow(ctx.resultFd, { "producer", ctx.spec.name, "write", writeLatency, 0, seconds });
+    }
+
+    void runConsumer(ChildContext& ctx, ClientDomain& domain) {
+        Slot* control = domain.getSlot(ControlSlot).ptr();
+        Waiter waiter(domain.ptr());
+        waiter.subscribeTo(control);
+        for (const auto& name : ctx.spec.slots) waiter.subscribeTo(domain.getSlot(name.c_str()).ptr());
+        waiter.registerConsumer(ctx.spec.name.c_str());
+
+        LatencyHistogram viewLatency, copyLatency;
+        uint64_t missed = 0;
+        bool stop       = false;
+
+        waitForGo(ctx.goFd);
+        const int64_t start = nowNanos();
+        while (!stop) {
+            // Sample before visiting, so a write in between makes the wait return.
+            uint32_t prv = domain.ptr()->seq.load();
+            waiter.forEachNewSlot([&](LockedView&& view, uint32_t skipped) {
+                if (view.slot == control) {
+                    stop = true;
+                    return;
+                }
+                viewLatency.record(nowNanos() - reinterpret_cast<const int64_t*>(view.span.ptr)[0]);
+                auto msg = view.cloneBytes();
+                copyLatency.record(nowNanos() - reinterpret_cast<const int64_t*>(msg.data())[0]);
+                missed += skipped;
+            });
+            if (!stop) domain.ptr()->seq.waitForChange(prv, waiter.wakeMask());
+        }
+
+        double seconds = (nowNanos() - start) / 1e9;
+        sendRow(ctx.resultFd, { "consumer", ctx.spec.name, "view", viewLatency, missed, seconds });
+        sendRow(ctx.resultFd, { "consumer", ctx.spec.name, "view+copy", copyLatency, missed, seconds });
+    }
+
+    [[noreturn]] void runChild(ChildContext ctx, int processIndex) {
+        int stat = 0;
+        try {
+            shiftMappings(ctx.topo, processIndex);
+            applyPlacement(ctx.spec, ctx.instance);
+            ClientDomain domain = ClientDomain::openOrCreate(ctx.topo.domain, DomainFileSize, ctx.topo.targetAddr);
+            SPDLOG_DEBUG("'{}' #{} (pid {}) mapped domain at {}", ctx.spec.name, ctx.instance, getpid(), (void*)domain.ptr());
+            if (ctx.spec.role == "producer") runProducer(ctx, domain);
+            else runConsumer(ctx, domain);
+        } catch (std::exception& e) {
+            SPDLOG_ERROR("'{}' #{} failed: {}", ctx.spec.name, ctx.instance, e.what());
+            stat = 1;
+        }
+        close(ctx.resultFd);
+        // Skip the parent's atexit handlers and static destructors.
+        _exit(stat);
+    }
+
+    // -----------------------------------------------------
+    // Parent
+    // -----------------------------------------------------
+
+    struct Child {
+        const ProcessSpec* spec;
+        int instance;
+        pid_t pid;
+        int resultFd;
+    };
+
+    int run(const Topology& topo) {
+        // Create everything up front so children only ever open existing files.
+        {
+            ClientDomain domain = ClientDomain::openOrCreate(topo.domain, DomainFileSize, topo.targetAddr);
+            domain.getSlot(ControlSlot);
+            for (const auto& s : topo.slots) domain.getSlot(s.name.c_str());
+        }
+
+        int goPipe[2];
+        if (pipe(goPipe) != 0) throw std::runtime_error("pipe() failed");
+
+        std::vector<Child> children;
+        int processIndex = 0;
+        for (const auto& spec : topo.processes) {
+            for (int i = 0; i < spec.count; i++, processIndex++) {
+                int resultPipe[2];
+                if (pipe(resultPipe) != 0) throw std::runtime_error("pipe() failed");
+                fflush(nullptr);
+                pid_t pid = fork();
+                if (pid < 0) throw std::runtime_error("fork() failed");
+                if (pid == 0) {
+                    close(goPipe[1]);
+                    close(resultPipe[0]);
+                    for (const auto& c : children) close(c.resultFd);
+                    runChild(ChildContext { topo, spec, i, goPipe[0], resultPipe[1] }, processIndex);
+                }
+                close(resultPipe[1]);
+                children.push_back(Child { &spec, i, pid, resultPipe[0] });
+            }
+        }
+        close(goPipe[0]);
+
+        SPDLOG_INFO("started {} processes, running for {} ms", children.size(), topo.durationMs);
+        usleep(100'000); // Let children map and subscribe before releasing them.
+        close(goPipe[1]);
+        usleep((topo.durationMs + 100) * 1000);
+
+        ClientDomain domain = ClientDomain::openOrCreate(topo.domain, DomainFileSize, topo.targetAddr);
+        uint64_t stopMsg[2] = { 0, 0 };
+        domain.getSlot(ControlSlot).write({ stopMsg, sizeof(stopMsg) });
+
+        // Per-process rows, then one merged row per spec when it has several instances.
+        ProfileResults results;
+        std::unordered_map<std::string, ProfileResults::Row> merged;
+        std::vector<std::string> mergedOrder;
+        int failures = 0;
+
+        for (auto& c : children) {
+            for (ProfileResults::Row row; recvRow(c.resultFd, row);) {
+                std::string name = c.spec->count > 1 ? fmt::format("{} #{}", row.name, c.instance) : row.name;
+                SPDLOG_INFO("{:>8} '{:>40}' {:>9} : {} (missed {}, {:.1f}/s)", row.role, name, row.metric, row.hist.summary(), row.missed,
+                            row.seconds > 0 ? row.hist.n / row.seconds : 0.);
+                results.add(row.role, name, row.metric, row.hist, row.missed, row.seconds);
+
+                if (c.spec->count > 1) {
+                    std::string key = fmt::format("{}|{}|{}", row.role, row.name, row.metric);
+                    auto it         = merged.find(key);
+                    if (it == merged.end()) {
+                        mergedOrder.push_back(key);
+                        merged[key] = row;
+                    } else {
+                        it->second.hist.merge(row.hist);
+                        it->second.missed += row.missed;
+                        it->second.seconds = std::max(it->second.seconds, row.seconds);
+                    }
+                }
+            }
+            close(c.resultFd);
+
+            int wstatus = 0;
+            waitpid(c.pid, &wstatus, 0);
+            if (!WIFEXITED(wstatus) or WEXITSTATUS(wstatus) != 0) {
+                SPDLOG_ERROR("'{}' #{} (pid {}) failed", c.spec->name, c.instance, c.pid);
+                failures++;
+            }
+        }
+
+        for (const auto& key : mergedOrder) {
+            const auto& r = merged[key];
+            SPDLOG_INFO("{:>8} '{:>40}' {:>9} : {} (missed {}, all instances)", r.role, r.name, r.metric, r.hist.summary(), r.missed);
+            results.add(r.role, r.name, r.metric, r.hist, r.missed, r.seconds);
+        }
+
+        if (const char* out = getenv("profileOut")) results.write(out, "babus-mp");
+        return failures == 0 ? 0 : 1;
+    }
+
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fmt::print(stderr, "usage: runProfileTopology <topology file> [durationMs]\n");
+        return 1;
+    }
+
+    try {
+        Topology topo = parseTopology(argv[1]);
+        if (argc > 2) topo.durationMs = std::stoll(argv[2]);
+        SPDLOG_INFO("topology '{}': domain '{}', {} slots, {} process specs, mapping {}", argv[1], topo.domain, topo.slots.size(),
+                    topo.processes.size(), topo.targetAddr ? fmt::format("fixed {}", topo.targetAddr) : "distinct");
+        return run(topo);
+    } catch (std::exception& e) {
+        SPDLOG_ERROR("{}", e.what());
+        return 1;
+    }
+}
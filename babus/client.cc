@@ -1,10 +1,17 @@
 #include "client.h"
 
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 namespace babus {
 
     namespace {
 
         void throwIfNotValidFileName(const char* s) {
+            if (strlen(s) >= MaxNameLength) throw std::runtime_error("name too long");
             for (int i = 0; s[i] != 0; i++) {
                 char c = s[i];
                 if (c == '/') throw std::runtime_error("name cannot have a '/'");
@@ -22,52 +29,119 @@ namespace babus {
     }
 
     ClientSlot ClientSlot::openOrCreate(Domain* dom, const std::string& name, std::size_t size, void* targetAddr) {
-        auto builder = MmapBuilder {};
-        Mmap mmap    = builder.path(std::string { Prefix } + name).allowCreate().size(size).targetAddr(targetAddr).build();
+        return openImpl(dom, name, size, targetAddr, true);
+    }
 
-        assert(reinterpret_cast<std::size_t>(mmap.ptr()) % 8 == 0);
-        auto ptr = reinterpret_cast<Slot*>(mmap.ptr());
+    ClientSlot ClientSlot::open(Domain* dom, const std::string& name, std::size_t size) {
+        return openImpl(dom, name, size, nullptr, false);
+    }
 
-        if (builder.didCreateFile()) {
-            SPDLOG_TRACE("construct Slot using placement new.");
-            new (ptr) Slot {};
-            memcpy(ptr->name, name.c_str(), name.length());
+    ClientSlot ClientSlot::openImpl(Domain* dom, const std::string& name, std::size_t size, void* targetAddr, bool allowCreate) {
+        // Registering is idempotent. Doing it on every open also re-populates the registry of a re-created domain.
+        // A slot we may not create must exist first, so a missing name does not take a registry entry.
+        if (!allowCreate and access((std::string { Prefix } + name).c_str(), F_OK) != 0) {
+            SPDLOG_ERROR("slot '{}' does not exist", name);
+            throw std::runtime_error("slot does not exist");
         }
+        uint32_t index = dom->registerSlot(name.c_str());
+
+        for (int attempt = 0;; attempt++) {
+            auto builder = MmapBuilder {};
+            builder.path(std::string { Prefix } + name).size(size).targetAddr(targetAddr);
+            if (allowCreate) builder.allowCreate();
+            builder.initializeWith([&](void* p) {
+                SPDLOG_TRACE("construct Slot using placement new.");
+                Slot* slot = new (p) Slot {};
+                memcpy(slot->name, name.c_str(), name.length());
+                slot->index = index;
+                // So a sweep running right now does not take the new file for idle.
+                slot->attachments().lastDetachNanos.store(monotonicNanos());
+            });
+            Mmap mmap = builder.build();
+
+            assert(reinterpret_cast<std::size_t>(mmap.ptr()) % 8 == 0);
+            auto ptr = reinterpret_cast<Slot*>(mmap.ptr());
+
+            if (!builder.didCreateFile() and ptr->index != index)
+                SPDLOG_WARN("slot '{}' has index {} but the domain registry has it at {}", name, ptr->index, index);
+
+            // SPDLOG_TRACE("check Slot magic @ 0x{:0x}", (std::size_t)ptr);
+            // if (!ptr->magicIsCorrect()) {
+            if (!magicMatches(ptr->magic, SlotMagic)) {
+                SPDLOG_ERROR("failed Slot magic check");
+                throw std::runtime_error("failed Slot magic check");
+            }
+            if (ptr->layoutVersion != SlotLayoutVersion) {
+                SPDLOG_ERROR("slot '{}' has layout version {:#x}, this build uses {:#x} (remove the stale file)", name, ptr->layoutVersion,
+                             SlotLayoutVersion);
+                throw std::runtime_error("failed Slot layout version check");
+            }
+
+            if (strcmp(ptr->name, name.c_str()) != 0) {
+                SPDLOG_ERROR("failed Slot name check (slot name '{}' != expected '{}')", ptr->name, name.c_str());
+                throw std::runtime_error("failed Slot name check");
+            }
+
+            // SPDLOG_CRITICAL("ini mtx val : {}", ptr->mtx.load());
+
+            // Attach, then check that nobody is removing the file under us. See the handshake in `attach.h`.
+            AttachTable& at = ptr->attachments();
+            int attachIndex = at.attach(traceThreadIds().pid);
+            if (at.removed.load() == 0) return ClientSlot { std::move(mmap), dom, attachIndex };
+            at.detach(attachIndex);
 
-        // SPDLOG_TRACE("check Slot magic @ 0x{:0x}", (std::size_t)ptr);
-        // if (!ptr->magicIsCorrect()) {
-        if (!magicMatches(ptr->magic, SlotMagic)) {
-            SPDLOG_ERROR("failed Slot magic check");
-            throw std::runtime_error("failed Slot magic check");
+            // The remover unlinks right after marking. If the mark stays, the remover died in between: finish its job.
+            SPDLOG_DEBUG("slot '{}' is being removed, opening it again", name);
+            if (attempt == 100) {
+                SPDLOG_WARN("slot '{}' stayed marked removed, unlinking it", name);
+                unlink((std::string { Prefix } + name).c_str());
+            }
+            if (attempt < 100) sched_yield();
         }
+    }
 
-        if (strcmp(ptr->name, name.c_str()) != 0) {
-            SPDLOG_ERROR("failed Slot name check (slot name '{}' != expected '{}')", ptr->name, name.c_str());
-            throw std::runtime_error("failed Slot name check");
+    AsyncPublisher& ClientSlot::asyncPublisher(uint32_t maxQueued) {
+        std::lock_guard<std::mutex> lck(*publisherMtx_);
+        if (!publisher_) {
+            publisher_ = std::make_unique<AsyncPublisher>(ptr(), domain_, maxQueued == 0 ? 2 : maxQueued);
+        } else if (maxQueued != 0 and maxQueued != publisher_->maxQueued()) {
+            SPDLOG_ERROR("slot '{}': asyncPublisher({}) but it was made with maxQueued {}", ptr()->name, maxQueued, publisher_->maxQueued());
+            throw std::runtime_error("asyncPublisher() with a different maxQueued");
         }
+        return *publisher_;
+    }
 
-        // SPDLOG_CRITICAL("ini mtx val : {}", ptr->mtx.load());
+    ClientDomain ClientDomain::openOrCreate(const std::string& name, std::size_t size, void* targetAddr) {
+        return openImpl(name, size, targetAddr, true);
+    }
 
-        return ClientSlot { std::move(mmap), dom };
+    ClientDomain ClientDomain::open(const std::string& name, std::size_t size) {
+        return openImpl(name, size, nullptr, false);
     }
 
-    ClientDomain ClientDomain::openOrCreate(const std::string& name, std::size_t size, void* targetAddr) {
+    ClientDomain ClientDomain::openImpl(const std::string& name, std::size_t size, void* targetAddr, bool allowCreate) {
         auto builder = MmapBuilder {};
-        Mmap mmap    = builder.path(std::string { Prefix } + name).allowCreate().size(size).targetAddr(targetAddr).build();
+        builder.path(std::string { Prefix } + name).size(size).targetAddr(targetAddr);
+        if (allowCreate) builder.allowCreate();
+        builder.initializeWith([](void* p) {
+            SPDLOG_TRACE("construct Domain using placement new.");
+            new (p) Domain {};
+        });
+        Mmap mmap = builder.build();
 
         assert(reinterpret_cast<std::size_t>(mmap.ptr()) % 8 == 0);
         auto ptr = reinterpret_cast<Domain*>(mmap.ptr());
 
-        if (builder.didCreateFile()) {
-            SPDLOG_TRACE("construct Domain using placement new.");
-            new (ptr) Domain {};
-        }
-
         // SPDLOG_TRACE("check Domain magic @ 0x{:0x}", (std::size_t)ptr);
         if (!magicMatches(ptr->magic, DomainMagic)) {
             SPDLOG_ERROR("failed Domain magic check");
             throw std::runtime_error("failed Domain magic check");
         }
+        if (ptr->layoutVersion != DomainLayoutVersion) {
+            SPDLOG_ERROR("domain '{}' has layout version {:#x}, this build uses {:#x} (remove the stale file)", name, ptr->layoutVersion,
+                         DomainLayoutVersion);
+            throw std::runtime_error("failed Domain layout version check");
+        }
 
         return ClientDomain(std::move(mmap));
     }
@@ -81,18 +155,135 @@ namespace babus {
 
         throwIfNotValidFileName(s);
 
-        auto newSlot = std::unique_ptr<ClientSlot>(new ClientSlot(ClientSlot::openOrCreate(ptr(), s)));
-        slots_.insert(s, std::move(newSlot));
+        return insertSlot(std::unique_ptr<ClientSlot>(new ClientSlot(ClientSlot::openOrCreate(ptr(), s))));
+    }
+
+    ClientSlot* ClientDomain::findSlot(const char* s) {
+        std::lock_guard<std::mutex> lck(processPrivateMtx_);
+
+        auto it = slots_.find(s);
+
+        if (it != slots_.end()) { return it->second.get(); }
+
+        throwIfNotValidFileName(s);
+        if (access((std::string { Prefix } + s).c_str(), F_OK) != 0) return nullptr;
+
+        return &insertSlot(std::unique_ptr<ClientSlot>(new ClientSlot(ClientSlot::open(ptr(), s))));
+    }
+
+    ClientSlot& ClientDomain::insertSlot(std::unique_ptr<ClientSlot>&& newSlot) {
+        // Key by the name stored in the slot header: the caller's name need not outlive the call.
+        const char* key = newSlot->ptr()->name;
+        slots_.insert(key, std::move(newSlot));
 
-        it = slots_.find(s);
+        auto it = slots_.find(key);
         if (it != slots_.end()) {
             return *it->second;
         } else {
-            SPDLOG_ERROR("just created+inserted slot '{}' but its missing?", s);
+            SPDLOG_ERROR("just created+inserted slot '{}' but its missing?", key);
             throw std::runtime_error("just created+inserted slot but its missing?");
         }
     }
 
+    bool ClientDomain::removeSlot(const char* s, bool force) {
+        std::lock_guard<std::mutex> lck(processPrivateMtx_);
+        if (slots_.find(s) != slots_.end()) slots_.erase(s);
+
+        std::string path = std::string { Prefix } + s;
+        int fd           = ::open(path.c_str(), O_RDWR);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 or std::size_t(st.st_size) < SlotDataOffset) {
+            close(fd);
+            SPDLOG_ERROR("removeSlot('{}'): not a slot file", s);
+            return false;
+        }
+        void* p = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) {
+            SPDLOG_ERROR("removeSlot('{}'): mmap failed with errno {} ('{}')", s, errno, strerror(errno));
+            return false;
+        }
+
+        Slot* slot = reinterpret_cast<Slot*>(p);
+        bool ok    = magicMatches(slot->magic, SlotMagic);
+        if (ok and slot->layoutVersion != SlotLayoutVersion) {
+            // Left by another build: its tables are not where this build looks, and no process of this build has it open.
+            SPDLOG_WARN("removeSlot('{}'): removing stale file of layout version {:#x}", s, slot->layoutVersion);
+            ok = unlink(path.c_str()) == 0;
+            if (ok) ptr()->unregisterSlot(s);
+        } else if (ok and !force and !slot->attachments().markRemoved(false)) {
+            SPDLOG_WARN("not removing slot '{}': other processes have it attached", s);
+            ok = false;
+        } else if (ok) {
+            uint32_t attached = 0;
+            if (force) {
+                attached = slot->attachments().numAlive();
+                if (attached > 0) SPDLOG_WARN("removing slot '{}' while {} other attachment(s) map it", s, attached);
+                slot->attachments().markRemoved(true);
+            }
+            // Free the data now instead of when the last process unmaps the file, unless someone still reads it.
+            if (attached == 0 and madvise(slot->data_ptr(), st.st_size - SlotDataOffset, MADV_REMOVE) != 0)
+                SPDLOG_WARN("removeSlot('{}'): madvise(MADV_REMOVE) failed with errno {} ('{}')", s, errno, strerror(errno));
+            ok = unlink(path.c_str()) == 0;
+            if (ok) ptr()->unregisterSlot(s);
+        } else {
+            SPDLOG_ERROR("removeSlot('{}'): failed Slot magic check", s);
+        }
+        munmap(p, st.st_size);
+        return ok;
+    }
+
+    uint32_t ClientDomain::sweepOrphanSlots(int64_t minIdleNanos) {
+        std::vector<std::string> names;
+        {
+            auto lck { ptr()->getSlotsReadLock() };
+            for (uint32_t i = 0; i < ptr()->numSlots and i < MaxSlots; i++)
+                if (ptr()->slotNames[i][0] != 0) names.emplace_back(ptr()->slotNames[i], strnlen(ptr()->slotNames[i], MaxNameLength));
+        }
+
+        uint32_t n = 0;
+        for (const auto& name : names) {
+            // Only the header page is needed.
+            std::string path = std::string { Prefix } + name;
+            int fd           = ::open(path.c_str(), O_RDWR);
+            if (fd < 0) continue;
+            struct stat st;
+            void* p = MAP_FAILED;
+            if (fstat(fd, &st) == 0 and std::size_t(st.st_size) >= SlotDataOffset)
+                p = mmap(nullptr, SlotDataOffset, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            if (p == MAP_FAILED) continue;
+
+            Slot* slot      = reinterpret_cast<Slot*>(p);
+            AttachTable& at = slot->attachments();
+            if (slot->hasCurrentLayout() and !(slot->flags.bits & SlotFlags::Persistent)
+                and monotonicNanos() - at.lastDetachNanos.load() >= minIdleNanos and at.markRemoved(false)) {
+                if (unlink(path.c_str()) == 0) {
+                    ptr()->unregisterSlot(name.c_str());
+                    SPDLOG_INFO("removed orphaned slot '{}'", name);
+                    n++;
+                }
+            }
+            munmap(p, SlotDataOffset);
+        }
+        return n;
+    }
+
+    Snapshot ClientDomain::readSnapshot(std::initializer_list<const char*> names) {
+        std::vector<Slot*> slots;
+        slots.reserve(names.size());
+        for (const char* name : names) {
+            ClientSlot* slot = findSlot(name);
+            if (slot == nullptr) {
+                SPDLOG_ERROR("readSnapshot(): slot '{}' does not exist", name);
+                throw std::runtime_error("readSnapshot() of a slot that does not exist");
+            }
+            slots.push_back(slot->ptr());
+        }
+        return babus::readSnapshot(slots);
+    }
+
 }
 
 namespace fmt {
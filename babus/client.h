@@ -1,6 +1,8 @@
 #pragma once
 
 #include "domain.h"
+#include "publisher.h"
+#include "snapshot.h"
 
 #include <spdlog/spdlog.h>
 
@@ -8,27 +10,45 @@ namespace babus {
 
     struct ClientSlot {
     private:
+        static ClientSlot openImpl(Domain* dom, const std::string& name, std::size_t size, void* targetAddr, bool allowCreate);
+
         Mmap mmap_;
         Domain* domain_;
+        int attachIndex_ = -1; // Our entry in the slot's `AttachTable`.
+        std::unique_ptr<AsyncPublisher> publisher_; // Made by the first `writeAsync()`.
+        // Guards making `publisher_`. Each `ClientSlot`, even a moved-to one, has its own.
+        std::unique_ptr<std::mutex> publisherMtx_ = std::make_unique<std::mutex>();
 
-        inline ClientSlot(Mmap&& mmap, Domain* dom)
+        inline ClientSlot(Mmap&& mmap, Domain* dom, int attachIndex)
             : mmap_(std::move(mmap))
-            , domain_(dom) {
+            , domain_(dom)
+            , attachIndex_(attachIndex) {
         }
 
     public:
         inline ClientSlot(ClientSlot&& o)
             : mmap_(std::move(o.mmap_))
-            , domain_(std::move(o.domain_)) {
+            , domain_(std::move(o.domain_))
+            , attachIndex_(o.attachIndex_)
+            , publisher_(std::move(o.publisher_)) {
         }
+        // Swaps, so `o` detaches from our old slot when destroyed.
         inline ClientSlot& operator=(ClientSlot&& o) {
+            // Finish async writes to our old slot while it is still mapped.
+            publisher_.reset();
             mmap_   = std::move(o.mmap_);
             domain_ = std::move(o.domain_);
+            std::swap(attachIndex_, o.attachIndex_);
+            publisher_ = std::move(o.publisher_);
             return *this;
         }
 
         static ClientSlot openOrCreate(Domain* dom, const std::string& name, std::size_t size = SlotFileSize, void* targetAddr = 0);
+        // Open an existing slot only. Throws if it does not exist.
+        static ClientSlot open(Domain* dom, const std::string& name, std::size_t size = SlotFileSize);
         inline ~ClientSlot() {
+            publisher_.reset();
+            if (ptr()) ptr()->attachments().detach(attachIndex_);
         }
 
         inline operator Slot&() {
@@ -37,6 +57,9 @@ namespace babus {
         inline Slot* ptr() const {
             return reinterpret_cast<Slot*>(mmap_.ptr());
         }
+        inline Domain* domain() const {
+            return domain_;
+        }
 
         inline uint8_t* data_ptr() const {
             return ptr()->data_ptr();
@@ -56,6 +79,29 @@ namespace babus {
         inline void write(ByteSpan span) {
             return ptr()->write(domain_, span);
         }
+        inline void writev(std::initializer_list<ByteSpan> pieces) {
+            return ptr()->writev(domain_, pieces);
+        }
+        inline void writeImage(const ImageLayout& layout, ByteSpan pixels) {
+            return ptr()->writeImage(domain_, layout, pixels);
+        }
+        inline WriteView beginWrite() {
+            return ptr()->beginWrite(domain_);
+        }
+
+        // Publish `buffer` from a background thread and return right away. See `publisher.h`.
+        inline std::future<bool> writeAsync(std::vector<uint8_t>&& buffer) {
+            return asyncPublisher().write(std::move(buffer));
+        }
+        inline void writeAsync(std::vector<uint8_t>&& buffer, AsyncPublisher::Done done) {
+            asyncPublisher().write(std::move(buffer), std::move(done));
+        }
+        // The publisher behind `writeAsync`, made on first use with room for `maxQueued` waiting messages (two if zero).
+        // Throws if it already exists with another non-zero `maxQueued`.
+        AsyncPublisher& asyncPublisher(uint32_t maxQueued = 0);
+        inline std::size_t residentBytes() const {
+            return ptr()->residentBytes(mmap_.size());
+        }
     };
 
     struct ClientDomain {
@@ -69,6 +115,11 @@ namespace babus {
         // Must use a unique_ptr here so that `getSlot` references remain valid after re-hashing etc.
         SmallMap<const char*, std::unique_ptr<ClientSlot>> slots_;
 
+        static ClientDomain openImpl(const std::string& name, std::size_t size, void* targetAddr, bool allowCreate);
+
+        // Map `newSlot` into `slots_` and return it. Called with `processPrivateMtx_` held.
+        ClientSlot& insertSlot(std::unique_ptr<ClientSlot>&& newSlot);
+
         inline ClientDomain(Mmap&& mmap)
             : mmap_(std::move(mmap)) {
         }
@@ -82,12 +133,30 @@ namespace babus {
 
     public:
         static ClientDomain openOrCreate(const std::string& path, std::size_t size = DomainFileSize, void* targetAddr = 0);
+        // Open an existing domain only (for tools). Throws if it does not exist.
+        static ClientDomain open(const std::string& path, std::size_t size = DomainFileSize);
 
         inline Domain* ptr() const {
             return reinterpret_cast<Domain*>(mmap_.ptr());
         }
 
         ClientSlot& getSlot(const char* s);
+        // Like `getSlot`, but never creates the slot: null if it does not exist.
+        ClientSlot* findSlot(const char* s);
+
+        // Unmap the slot here and remove its file, returning its memory right away. Invalidates references from
+        // `getSlot(s)`. Frees the slot's registry entry for reuse. False if there was no file, or if another live
+        // process has the slot attached. With `force` the file goes anyway: attached processes keep the old memory,
+        // which is only freed once they unmap it, and no longer see new writes.
+        bool removeSlot(const char* s, bool force = false);
+
+        // Remove the files of registered slots that no process has attached for `minIdleNanos` and that are not
+        // `SlotFlags::Persistent`. Never runs on its own. Returns how many were removed. See `attach.h`.
+        uint32_t sweepOrphanSlots(int64_t minIdleNanos = OrphanSlotIdleNanos);
+
+        // Copy several slots such that all copies correspond to one point in time. See `snapshot.h`.
+        // Throws if any of them does not exist.
+        Snapshot readSnapshot(std::initializer_list<const char*> names);
         friend struct fmt::formatter<ClientDomain>;
     };
 
@@ -13,13 +13,42 @@ namespace babus {
         constexpr std::array<char, 4> SlotMagic   = { 's', 'l', 'o', 't' };
         constexpr std::array<char, 4> DomainMagic = { 'd', 'o', 'm', ' ' };
 
+        // Stored right after the magic. Bump on every change to the layout of the slot or domain file, so files left
+        // in /dev/shm by another build are rejected instead of misread. Files from before the version word existed
+        // have a lock word at its offset; starting at `1 << 16` keeps the versions clear of lock values.
+        constexpr uint32_t SlotLayoutVersion      = (1 << 16) + 3;
+        constexpr uint32_t DomainLayoutVersion    = (1 << 16) + 3;
+
         constexpr std::size_t MaxNameLength       = 32;
+        constexpr std::size_t MaxSlots            = 64; // per Domain. Slot `index` is in [0, MaxSlots).
+        constexpr uint32_t UnregisteredSlotIndex  = MaxSlots; // `index` of slots opened while the registry was full.
+        constexpr std::size_t MaxPollers          = 32; // per Domain. See `pollfd.h`.
+        constexpr std::size_t MaxConsumers        = 32; // per Slot. See `consumers.h`.
 
         constexpr std::size_t DomainFileSize      = (4 * (1 << 20));
+        constexpr std::size_t DomainTraceOffset   = (1 << 20); // `TraceRing`, see `trace.h`.
+        constexpr std::size_t TraceRingCapacity   = (1 << 16); // records (32 bytes each).
         constexpr std::size_t SlotFileSize        = (16 * (1 << 20));
-        constexpr std::size_t SlotDataOffset      = 256; // space allocated for slot header.
+        constexpr std::size_t SlotStatsOffset     = 256;  // `SlotStats` block, see `stats.h`.
+        constexpr std::size_t SlotAttachOffset    = 1280; // `AttachTable`, see `attach.h`.
+        constexpr std::size_t SlotConsumersOffset = 1536; // `ConsumerTable`, see `consumers.h`.
+        constexpr std::size_t SlotLockOwnersOffset = 3840; // `LockOwners` of the slot's `RwMutex`, see `rw_mutex.hpp`.
+        constexpr std::size_t SlotDataOffset      = 4096; // space allocated for slot header + stats.
+        constexpr std::size_t SlotDataCapacity    = SlotFileSize - SlotDataOffset;
 
         constexpr std::size_t SlotItemOffset      = 4096;
         constexpr std::size_t SlotMaxRingLength   = 8;
+
+        // How long a slot must have had no live attachers before `ClientDomain::sweepOrphanSlots()` removes it.
+        constexpr int64_t OrphanSlotIdleNanos     = 60'000'000'000;
+
+        // Threads that sleep on the domain futex for a `CoroExecutor`, `Dispatcher` or `Graph` wake up this often to check whether
+        // they were stopped. Waking them through the shared counter instead would wake other processes' waiters too.
+        constexpr int64_t StopCheckNanos          = 20'000'000;
+
+        // A slot whose messages stayed below its high-water mark this long releases the pages beyond them, if that
+        // frees at least `SlotTrimMinBytes`. Per slot in `Slot::trimAfterNanos`; this is the default.
+        constexpr int64_t SlotTrimAfterNanos      = 10'000'000'000;
+        constexpr std::size_t SlotTrimMinBytes    = (1 << 20);
     }
 }
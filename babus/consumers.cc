@@ -0,0 +1,33 @@
+#include "consumers.h"
+#include "detail/claim_entry.hpp"
+#include "stats.h"
+#include "trace.h"
+
+#include <spdlog/spdlog.h>
+
+#include <cstring>
+
+namespace babus {
+
+    ConsumerEntry* ConsumerTable::claim(const char* name, uint32_t seq) {
+        ConsumerEntry* entry = claimEntry(entries, [](ConsumerEntry& e) {
+            SPDLOG_WARN("reclaiming consumer entry '{}' of dead pid {}", e.name, e.pid);
+        });
+        if (entry == nullptr) return nullptr;
+
+        entry->seq.store(seq);
+        entry->delivered.store(0);
+        entry->skipped.store(0);
+        entry->lastReadNanos.store(monotonicNanos());
+        entry->pid = traceThreadIds().pid;
+        memset(entry->name, 0, sizeof(entry->name));
+        strncpy(entry->name, name, sizeof(entry->name) - 1);
+        entry->state.store(ConsumerEntry::Active);
+        return entry;
+    }
+
+    void ConsumerTable::release(ConsumerEntry* entry) {
+        if (entry) entry->state.store(ConsumerEntry::Free);
+    }
+
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "babus/common.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace babus {
+
+    //
+    // Each slot file keeps a table of the consumers reading it (at `SlotConsumersOffset`), so publishers and
+    // tools (`babusctl ls`) can see how far behind each one is before an overloaded consumer causes trouble.
+    //
+    // A `Waiter` claims one entry per subscribed slot after `Waiter::registerConsumer(name)` and updates it on
+    // every dispatch. Entries are released when the subscription ends. Entries of processes that died
+    // without releasing them are reclaimed when the table is full.
+    //
+
+    struct ConsumerEntry {
+        static constexpr uint32_t Free   = 0;
+        static constexpr uint32_t Busy   = 1; // Claimed, being (de)initialized.
+        static constexpr uint32_t Active = 2;
+
+        std::atomic<uint32_t> state;
+        std::atomic<uint32_t> seq;       // Sequence number of the last message handed to the consumer.
+        std::atomic<uint64_t> delivered; // Messages handed to the consumer.
+        std::atomic<uint64_t> skipped;   // Messages overwritten before the consumer got to them.
+        std::atomic<int64_t> lastReadNanos;
+        int32_t pid;
+        uint32_t pad_;
+        char name[MaxNameLength];
+
+        // Called by the consumer on every dispatch.
+        inline void record(uint32_t newSeq, uint32_t numSkipped, int64_t nowNanos) {
+            constexpr auto relaxed = std::memory_order_relaxed;
+            seq.store(newSeq, relaxed);
+            delivered.fetch_add(1, relaxed);
+            if (numSkipped) skipped.fetch_add(numSkipped, relaxed);
+            lastReadNanos.store(nowNanos, relaxed);
+        }
+    };
+
+    struct ConsumerTable {
+        ConsumerEntry entries[MaxConsumers];
+
+        // Null if the table is full.
+        ConsumerEntry* claim(const char* name, uint32_t seq);
+        static void release(ConsumerEntry* entry);
+
+        // How many messages the slowest active consumer is behind `slotSeq`. Zero without consumers.
+        inline uint32_t maxLag(uint32_t slotSeq) const {
+            uint32_t lag = 0;
+            for (const auto& e : entries) {
+                if (e.state.load(std::memory_order_relaxed) != ConsumerEntry::Active) continue;
+                uint32_t l = slotSeq - e.seq.load(std::memory_order_relaxed);
+                if (l > lag) lag = l;
+            }
+            return lag;
+        }
+    };
+
+    static_assert(SlotConsumersOffset + sizeof(ConsumerTable) <= SlotLockOwnersOffset,
+                  "ConsumerTable does not fit before SlotLockOwnersOffset");
+
+}
@@ -0,0 +1,341 @@
+#include "copy.h"
+
+#include <spdlog/spdlog.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace babus {
+
+    namespace {
+
+        using CopyKernel = void (*)(void*, const void*, std::size_t);
+
+#if defined(__x86_64__)
+        // Each kernel copies up to the first vector-aligned destination address with `memcpy`, streams whole blocks,
+        // then copies the rest with `memcpy`. There is no software prefetch: the hardware prefetcher already follows a
+        // sequential source, and `prefetchnta`/`prefetcht0` ahead of the loads measured slower or no different.
+        // The `sfence` orders the streamed stores before the caller's release of the write lock and `seq` increment,
+        // which readers synchronize with.
+
+        __attribute__((target("sse2"))) void streamSse2(void* dst, const void* src, std::size_t n) {
+            uint8_t* d       = static_cast<uint8_t*>(dst);
+            const uint8_t* s = static_cast<const uint8_t*>(src);
+            std::size_t head = (16 - (reinterpret_cast<uintptr_t>(d) & 15)) & 15;
+            std::memcpy(d, s, head);
+            d += head, s += head, n -= head;
+            for (; n >= 64; d += 64, s += 64, n -= 64) {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 16));
+                __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 32));
+                __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 48));
+                _mm_stream_si128(reinterpret_cast<__m128i*>(d), a);
+                _mm_stream_si128(reinterpret_cast<__m128i*>(d + 16), b);
+                _mm_stream_si128(reinterpret_cast<__m128i*>(d + 32), c);
+                _mm_stream_si128(reinterpret_cast<__m128i*>(d + 48), e);
+            }
+            _mm_sfence();
+            std::memcpy(d, s, n);
+        }
+
+        __attribute__((target("avx2"))) void streamAvx2(void* dst, const void* src, std::size_t n) {
+            uint8_t* d       = static_cast<uint8_t*>(dst);
+            const uint8_t* s = static_cast<const uint8_t*>(src);
+            std::size_t head = (32 - (reinterpret_cast<uintptr_t>(d) & 31)) & 31;
+            std::memcpy(d, s, head);
+            d += head, s += head, n -= head;
+            for (; n >= 128; d += 128, s += 128, n -= 128) {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s));
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 32));
+                __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 64));
+                __m256i e = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + 96));
+                _mm256_stream_si256(reinterpret_cast<__m256i*>(d), a);
+                _mm256_stream_si256(reinterpret_cast<__m256i*>(d + 32), b);
+                _mm256_stream_si256(reinterpret_cast<__m256i*>(d + 64), c);
+                _mm256_stream_si256(reinterpret_cast<__m256i*>(d + 96), e);
+            }
+            _mm_sfence();
+            std::memcpy(d, s, n);
+        }
+
+        __attribute__((target("avx512f"))) void streamAvx512(void* dst, const void* src, std::size_t n) {
+            uint8_t* d       = static_cast<uint8_t*>(dst);
+            const uint8_t* s = static_cast<const uint8_t*>(src);
+            std::size_t head = (64 - (reinterpret_cast<uintptr_t>(d) & 63)) & 63;
+            std::memcpy(d, s, head);
+            d += head, s += head, n -= head;
+            for (; n >= 256; d += 256, s += 256, n -= 256) {
+                __m512i a = _mm512_loadu_si512(s);
+                __m512i b = _mm512_loadu_si512(s + 64);
+                __m512i c = _mm512_loadu_si512(s + 128);
+                __m512i e = _mm512_loadu_si512(s + 192);
+                _mm512_stream_si512(reinterpret_cast<__m512i*>(d), a);
+                _mm512_stream_si512(reinterpret_cast<__m512i*>(d + 64), b);
+                _mm512_stream_si512(reinterpret_cast<__m512i*>(d + 128), c);
+                _mm512_stream_si512(reinterpret_cast<__m512i*>(d + 192), e);
+            }
+            _mm_sfence();
+            std::memcpy(d, s, n);
+        }
+#endif
+
+        struct Kernel {
+            CopyKernel stream;
+            const char* name;
+        };
+
+        Kernel pickKernel() {
+#if defined(__x86_64__)
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f")) return { streamAvx512, "avx512" };
+            if (__builtin_cpu_supports("avx2")) return { streamAvx2, "avx2" };
+            return { streamSse2, "sse2" };
+#else
+            return { nullptr, "memcpy" };
+#endif
+        }
+
+        std::size_t initialThreshold() {
+            const char* env = getenv("BABUS_STREAMING_COPY");
+            if (env == nullptr) return DefaultStreamingCopyThreshold;
+            char* end;
+            unsigned long long v = strtoull(env, &end, 10);
+            if (end == env or *end != '\0') {
+                SPDLOG_WARN("ignoring BABUS_STREAMING_COPY='{}', expected a number of bytes", env);
+                return DefaultStreamingCopyThreshold;
+            }
+            return v == 0 ? SIZE_MAX : std::size_t(v);
+        }
+
+        const Kernel kernel = pickKernel();
+        std::atomic<std::size_t> threshold { initialThreshold() };
+
+        inline void copySingle(void* dst, const void* src, std::size_t n, bool stream) {
+            if (stream)
+                kernel.stream(dst, src, n);
+            else
+                std::memcpy(dst, src, n);
+        }
+
+        // -----------------------------------------------------
+        // Parallel copies
+        // -----------------------------------------------------
+
+        // The CPUs of the NUMA node `cpu` is on, from sysfs. Empty if there is only one node or sysfs has no answer.
+        std::vector<int> cpusOfNode(int cpu) {
+            std::vector<int> out;
+            if (access("/sys/devices/system/node/node1", F_OK) != 0) return out;
+
+            int node   = -1;
+            DIR* dir   = opendir(fmt::format("/sys/devices/system/cpu/cpu{}", cpu).c_str());
+            if (dir == nullptr) return out;
+            while (dirent* e = readdir(dir))
+                if (strncmp(e->d_name, "node", 4) == 0) node = atoi(e->d_name + 4);
+            closedir(dir);
+            if (node < 0) return out;
+
+            // e.g. "0-13,28-41"
+            std::ifstream in(fmt::format("/sys/devices/system/node/node{}/cpulist", node));
+            std::string range;
+            while (std::getline(in, range, ',')) {
+                int lo, hi;
+                int n = sscanf(range.c_str(), "%d-%d", &lo, &hi);
+                if (n == 1) hi = lo;
+                if (n >= 1)
+                    for (int c = lo; c <= hi; c++) out.push_back(c);
+            }
+            return out;
+        }
+
+        // One parallel copy. Shared with the helpers, so one that wakes up late only ever sees a finished job.
+        struct CopyJob {
+            uint8_t* dst;
+            const uint8_t* src;
+            std::size_t n;
+            std::size_t head;  // Bytes before the first page boundary of `dst`, copied with chunk 0.
+            std::size_t chunk; // A multiple of the page size.
+            uint32_t numChunks;
+            bool stream;
+            std::atomic<uint32_t> next { 0 };
+            std::atomic<uint32_t> done { 0 };
+
+            // Copy chunks until none are left. True if this thread finished the last one.
+            inline bool work() {
+                uint32_t i, mine = 0;
+                while ((i = next.fetch_add(1)) < numChunks) {
+                    std::size_t from = i == 0 ? 0 : head + i * chunk;
+                    std::size_t to   = std::min(n, head + (i + 1) * chunk);
+                    copySingle(dst + from, src + from, to - from, stream);
+                    mine++;
+                }
+                return mine > 0 and done.fetch_add(mine) + mine == numChunks;
+            }
+        };
+
+        class CopyPool {
+        public:
+            CopyPool(uint32_t helpers)
+                : pid_(getpid()) {
+                int cpu              = sched_getcpu();
+                std::vector<int> cpus = cpu < 0 ? std::vector<int> {} : cpusOfNode(cpu);
+                for (uint32_t i = 0; i < helpers; i++) {
+                    threads_.emplace_back([this] { helperLoop(); });
+                    if (!cpus.empty()) {
+                        cpu_set_t set;
+                        CPU_ZERO(&set);
+                        for (int c : cpus) CPU_SET(c, &set);
+                        if (int err = pthread_setaffinity_np(threads_.back().native_handle(), sizeof(set), &set); err != 0)
+                            SPDLOG_WARN("could not pin copy helper to the NUMA node of cpu {}: {}", cpu, strerror(err));
+                    }
+                }
+            }
+
+            ~CopyPool() {
+                {
+                    std::lock_guard<std::mutex> lck(mtx_);
+                    stop_ = true;
+                }
+                jobCv_.notify_all();
+                for (auto& t : threads_) t.join();
+            }
+
+            uint32_t helpers() const {
+                return threads_.size();
+            }
+
+            // False, without copying, if the pool is busy with another copy.
+            bool copy(void* dst, const void* src, std::size_t n, bool stream) {
+                // In a forked child the helpers are gone, and a mutex one of them held at the fork stays locked.
+                if (getpid() != pid_) return false;
+                const std::size_t page = sysconf(_SC_PAGESIZE);
+                if (n < 2 * page) return false;
+                std::unique_lock<std::mutex> busy(busyMtx_, std::try_to_lock);
+                if (!busy.owns_lock()) return false;
+
+                auto job               = std::make_shared<CopyJob>();
+                job->dst               = static_cast<uint8_t*>(dst);
+                job->src               = static_cast<const uint8_t*>(src);
+                job->n                 = n;
+                job->stream            = stream;
+                job->head              = (page - reinterpret_cast<uintptr_t>(dst) % page) % page;
+                // A few chunks per thread, so a helper that wakes up late does not hold everyone up.
+                std::size_t parts = 4 * (threads_.size() + 1);
+                job->chunk        = ((n - job->head) / parts + page - 1) / page * page;
+                job->numChunks    = (n - job->head + job->chunk - 1) / job->chunk;
+
+                {
+                    std::lock_guard<std::mutex> lck(mtx_);
+                    job_ = job;
+                }
+                jobCv_.notify_all();
+
+                if (!job->work()) {
+                    std::unique_lock<std::mutex> lck(mtx_);
+                    doneCv_.wait(lck, [&] { return job->done.load() == job->numChunks; });
+                }
+                std::lock_guard<std::mutex> lck(mtx_);
+                job_.reset();
+                return true;
+            }
+
+        private:
+            void helperLoop() {
+                std::shared_ptr<CopyJob> last;
+                for (;;) {
+                    std::shared_ptr<CopyJob> job;
+                    {
+                        std::unique_lock<std::mutex> lck(mtx_);
+                        jobCv_.wait(lck, [&] { return stop_ or (job_ != nullptr and job_ != last); });
+                        if (stop_) return;
+                        job = last = job_;
+                    }
+                    if (job->work()) {
+                        std::lock_guard<std::mutex> lck(mtx_);
+                        doneCv_.notify_one();
+                    }
+                }
+            }
+
+            const pid_t pid_;
+            std::vector<std::thread> threads_;
+
+            std::mutex busyMtx_; // Held by the thread whose copy is using the pool.
+            std::mutex mtx_;
+            std::condition_variable jobCv_, doneCv_;
+            std::shared_ptr<CopyJob> job_;
+            bool stop_ = false;
+        };
+
+        std::shared_ptr<CopyPool> pool;
+        std::atomic<std::size_t> parallelMinBytes { SIZE_MAX }; // SIZE_MAX while there is no pool.
+
+        // A forked child has the pool but not its threads. Destroying it there would join threads that do not exist and
+        // could block on mutexes and condition variables that helpers were using at the fork, so the child leaks it
+        // and copies on its own thread until it calls `setParallelCopy()` itself. Only the forking thread runs here,
+        // so `pool` is not touched concurrently.
+        const bool forgetPoolInChild = [] {
+            pthread_atfork(nullptr, nullptr, [] {
+                parallelMinBytes.store(SIZE_MAX);
+                new std::shared_ptr<CopyPool>(std::move(pool));
+            });
+            return true;
+        }();
+
+        const bool poolFromEnv = [] {
+            if (const char* env = getenv("BABUS_COPY_THREADS"); env != nullptr and atoi(env) > 0) setParallelCopy(atoi(env));
+            return true;
+        }();
+
+    }
+
+    namespace detail {
+        void copyLarge(void* dst, const void* src, std::size_t n) {
+            bool stream = kernel.stream != nullptr and n >= threshold.load(std::memory_order_relaxed);
+            if (n >= parallelMinBytes.load(std::memory_order_relaxed)) {
+                if (auto p = std::atomic_load(&pool); p != nullptr and p->copy(dst, src, n, stream)) return;
+            }
+            copySingle(dst, src, n, stream);
+        }
+    }
+
+    std::size_t streamingCopyThreshold() {
+        return threshold.load();
+    }
+    void setStreamingCopyThreshold(std::size_t bytes) {
+        threshold.store(bytes == 0 ? SIZE_MAX : bytes);
+    }
+
+    const char* copyKernelName() {
+        return kernel.name;
+    }
+
+    void setParallelCopy(uint32_t helpers, std::size_t minBytes) {
+        std::shared_ptr<CopyPool> next;
+        if (helpers > 0) next = std::make_shared<CopyPool>(helpers);
+        parallelMinBytes.store(SIZE_MAX);
+        std::atomic_store(&pool, next);
+        if (next != nullptr) parallelMinBytes.store(minBytes);
+    }
+
+    uint32_t parallelCopyHelpers() {
+        auto p = std::atomic_load(&pool);
+        return p == nullptr ? 0 : p->helpers();
+    }
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace babus {
+
+    //
+    // Copies between user buffers and slot data. Small copies are an inline `memcpy`. Large ones go to a kernel picked
+    // once for the CPU (AVX-512, AVX2 or SSE2 on x86-64, plain `memcpy` elsewhere). From `streamingCopyThreshold()`
+    // bytes up, that kernel uses non-temporal stores. A multi-megabyte frame then goes straight to memory, without
+    // first reading the destination lines in and evicting the copier's working set to make room for them.
+    //
+    // Below the threshold the kernel is the libc `memcpy`. It is already vectorized, and its stores leave the data in
+    // cache, which is what you want when the reader runs right after.
+    //
+
+    // Copies up to this size are always an inline `memcpy`.
+    constexpr std::size_t SmallCopyBytes = 256;
+
+    namespace detail {
+        void copyLarge(void* dst, const void* src, std::size_t n);
+    }
+
+    inline void copyBytes(void* dst, const void* src, std::size_t n) {
+        if (n <= SmallCopyBytes)
+            std::memcpy(dst, src, n);
+        else
+            detail::copyLarge(dst, src, n);
+    }
+
+    // Copies of at least this many bytes use non-temporal stores. Defaults to `DefaultStreamingCopyThreshold`, or
+    // `BABUS_STREAMING_COPY` bytes from the environment (0 disables streaming).
+    constexpr std::size_t DefaultStreamingCopyThreshold = 4 << 20;
+    std::size_t streamingCopyThreshold();
+    void setStreamingCopyThreshold(std::size_t bytes);
+
+    // The kernel picked for this CPU: "avx512", "avx2", "sse2" or "memcpy".
+    const char* copyKernelName();
+
+    // Parallel copies (off by default). With `helpers` > 0, copies of at least `minBytes` are split into page-aligned
+    // chunks that the calling thread and a pool of `helpers` persistent threads copy together. A writer then holds the
+    // slot's write lock for a fraction of the time on big frames, if the machine has the memory bandwidth to spare.
+    // Helpers are pinned to the NUMA node of the thread that calls this. Only one copy at a time uses the pool. Others
+    // that start meanwhile copy on their own thread.
+    //
+    // Call it at startup, not while copies are running. `BABUS_COPY_THREADS=<helpers>` in the environment does the
+    // same with the default `minBytes`.
+    constexpr std::size_t DefaultParallelCopyMinBytes = 8 << 20;
+    void setParallelCopy(uint32_t helpers, std::size_t minBytes = DefaultParallelCopyMinBytes);
+    uint32_t parallelCopyHelpers();
+
+}
@@ -0,0 +1,261 @@
+#pragma once
+
+#ifndef __cpp_impl_coroutine
+#error "babus/coro.h requires C++20 coroutines (e.g. -std=c++20)."
+#endif
+
+#include "client.h"
+#include "waiter.h"
+
+#include <coroutine>
+#include <exception>
+#include <vector>
+
+namespace babus {
+
+    //
+    // Coroutine API for consuming slots without an OS thread per consumer.
+    //
+    //      babus::CoroTask consume(babus::Slot* slot) {
+    //          uint32_t seq = slot->seq.load();
+    //          while (true) {
+    //              seq = co_await babus::nextAfter(slot, seq);
+    //              auto view = slot->read();
+    //              ...
+    //          }
+    //      }
+    //
+    //      babus::CoroExecutor ex(domain.ptr());
+    //      ex.spawn(consume(slotA));
+    //      ex.spawn(consume(slotB));
+    //      ex.run();
+    //
+    // The executor is single-threaded. Every parked coroutine contributes its futex bits to one union mask,
+    // and the executor sleeps in a single `FUTEX_WAIT_BITSET` on the domain sequence counter. That is the
+    // same mechanism `Waiter::waitExclusive` uses, so hundreds of consumers cost one sleeping thread.
+    //
+    // NOTE: This header is C++20, the rest of babus is C++17. Nothing in the library depends on it, and the awaitables
+    //       are free functions rather than members of `Slot`/`Waiter`, so those classes are the same in both.
+    //
+
+    class CoroExecutor;
+
+    // A coroutine that can be spawned on a `CoroExecutor`. It starts suspended and is owned by the executor.
+    struct CoroTask {
+        struct promise_type {
+            std::exception_ptr exception;
+
+            inline CoroTask get_return_object() {
+                return CoroTask { std::coroutine_handle<promise_type>::from_promise(*this) };
+            }
+            inline std::suspend_always initial_suspend() noexcept {
+                return {};
+            }
+            inline std::suspend_always final_suspend() noexcept {
+                return {};
+            }
+            inline void return_void() {
+            }
+            inline void unhandled_exception() {
+                exception = std::current_exception();
+            }
+        };
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    class CoroExecutor {
+    public:
+        inline CoroExecutor(Domain* domain)
+            : domain_(domain) {
+        }
+        inline ~CoroExecutor() {
+            for (auto h : tasks_) h.destroy();
+        }
+        CoroExecutor(const CoroExecutor&)            = delete;
+        CoroExecutor& operator=(const CoroExecutor&) = delete;
+
+        inline void spawn(CoroTask&& task) {
+            tasks_.push_back(task.handle);
+            ready_.push_back(task.handle);
+        }
+
+        // Run until every task finished or `stop()` was called.
+        // An exception escaping a task is re-thrown here (after that task is destroyed).
+        inline void run() {
+            CoroExecutor* prevExecutor = current();
+            current()                  = this;
+            stop_.store(false);
+
+            try {
+                while (!stop_.load() and !tasks_.empty()) {
+                    if (ready_.empty()) waitForReady();
+                    resumeReady();
+                }
+            } catch (...) {
+                current() = prevExecutor;
+                throw;
+            }
+
+            current() = prevExecutor;
+        }
+
+        // May be called from any thread, or from inside a task. From another thread, `run()` returns within
+        // `StopCheckNanos`: the executor is not woken through the shared domain counter.
+        inline void stop() {
+            stop_.store(true);
+        }
+
+        inline std::size_t numTasks() const {
+            return tasks_.size();
+        }
+
+        // The executor running on this thread, if any. Awaitables park themselves with it.
+        static inline CoroExecutor*& current() {
+            static thread_local CoroExecutor* executor = nullptr;
+            return executor;
+        }
+
+        // Used by the awaitables below. Exactly one of `slot` or `waiter` is set.
+        struct Parked {
+            std::coroutine_handle<> handle;
+            Slot* slot       = nullptr;
+            uint32_t seq     = 0;
+            uint32_t* result = nullptr;
+            Waiter* waiter   = nullptr;
+
+            inline bool isReady() const {
+                if (slot) {
+                    uint32_t cur = slot->seq.load();
+                    if (cur <= seq) return false;
+                    *result = cur;
+                    return true;
+                }
+                return waiter->hasNewSlots();
+            }
+
+            inline uint32_t mask() const {
+                return slot ? slot->eventMask() : waiter->waitMask();
+            }
+        };
+
+        inline void park(Parked&& p) {
+            parked_.push_back(std::move(p));
+        }
+
+    private:
+        Domain* domain_;
+        std::atomic<bool> stop_ { false };
+
+        std::vector<std::coroutine_handle<CoroTask::promise_type>> tasks_;
+        std::vector<std::coroutine_handle<>> ready_;
+        std::vector<Parked> parked_;
+
+        // Move satisfied parked coroutines to `ready_`. Returns the union mask of the ones still parked.
+        inline uint32_t pollParked() {
+            uint32_t mask = 0;
+            for (std::size_t i = 0; i < parked_.size();) {
+                if (parked_[i].isReady()) {
+                    ready_.push_back(parked_[i].handle);
+                    parked_[i] = std::move(parked_.back());
+                    parked_.pop_back();
+                } else {
+                    mask |= parked_[i].mask();
+                    i++;
+                }
+            }
+            return mask;
+        }
+
+        inline void waitForReady() {
+            while (ready_.empty() and !stop_.load()) {
+                // Sample the domain counter *before* checking, so a write in between makes the futex wait return.
+                uint32_t prv  = domain_->seq.load();
+                uint32_t mask = pollParked();
+                if (!ready_.empty()) return;
+                if (mask == 0) {
+                    SPDLOG_ERROR("CoroExecutor has tasks but none are ready or parked on a slot.");
+                    throw std::runtime_error("CoroExecutor deadlock");
+                }
+                domain_->seq.waitForChangeFor(prv, mask, StopCheckNanos);
+            }
+        }
+
+        inline void resumeReady() {
+            std::vector<std::coroutine_handle<>> batch;
+            batch.swap(ready_);
+
+            // Keep resuming the rest of the batch if one task throws, then re-throw the first exception.
+            std::exception_ptr exception;
+            for (auto h : batch) {
+                h.resume();
+                if (h.done()) {
+                    auto e = finish(h);
+                    if (e and !exception) exception = e;
+                }
+            }
+            if (exception) std::rethrow_exception(exception);
+        }
+
+        inline std::exception_ptr finish(std::coroutine_handle<> h) {
+            for (std::size_t i = 0; i < tasks_.size(); i++) {
+                if (tasks_[i].address() != h.address()) continue;
+                auto task = tasks_[i];
+                tasks_[i] = tasks_.back();
+                tasks_.pop_back();
+
+                std::exception_ptr exception = task.promise().exception;
+                task.destroy();
+                return exception;
+            }
+            return nullptr;
+        }
+    };
+
+    struct SlotNextAwaitable {
+        Slot* slot;
+        uint32_t seq;
+        uint32_t result = 0;
+
+        inline bool await_ready() {
+            result = slot->seq.load();
+            return result > seq;
+        }
+        inline void await_suspend(std::coroutine_handle<> h) {
+            CoroExecutor* ex = CoroExecutor::current();
+            assert(ex != nullptr && "co_await nextAfter() outside of a running CoroExecutor");
+            ex->park(CoroExecutor::Parked { h, slot, seq, &result, nullptr });
+        }
+        inline uint32_t await_resume() {
+            return result;
+        }
+    };
+
+    struct NextSlotAwaitable {
+        Waiter* waiter;
+
+        inline bool await_ready() {
+            return waiter->hasNewSlots();
+        }
+        inline void await_suspend(std::coroutine_handle<> h) {
+            CoroExecutor* ex = CoroExecutor::current();
+            assert(ex != nullptr && "co_await next() outside of a running CoroExecutor");
+            ex->park(CoroExecutor::Parked { h, nullptr, 0, nullptr, waiter });
+        }
+        inline void await_resume() {
+        }
+    };
+
+    // `co_await nextAfter(slot, seq)` resumes with the slot's sequence number once it exceeds `seq`.
+    inline SlotNextAwaitable nextAfter(Slot* slot, uint32_t seq) {
+        return SlotNextAwaitable { slot, seq };
+    }
+    inline SlotNextAwaitable nextAfter(const ClientSlot& slot, uint32_t seq) {
+        return SlotNextAwaitable { slot.ptr(), seq };
+    }
+    // `co_await next(waiter)` resumes once `waiter.hasNewSlots()`.
+    inline NextSlotAwaitable next(Waiter& waiter) {
+        return NextSlotAwaitable { &waiter };
+    }
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "rw_mutex.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace babus {
+
+    //
+    // Claim an entry of a per-process table in shared memory (`PollerTable`, `ConsumerTable`). Entries have a `state`
+    // that is `Entry::Free`, `Entry::Busy` (being (de)initialized) or `Entry::Active`, and the `pid` of their owner.
+    //
+    // Takes a free entry if there is one. Otherwise steals an active entry of a process that died without releasing it,
+    // calling `onSteal(entry)` first. The claimed entry is `Busy`: the caller fills it in and then makes it `Active`.
+    // Null if every entry belongs to a live process.
+    //
+    template <class Entry, std::size_t N, class OnSteal> inline Entry* claimEntry(Entry (&entries)[N], OnSteal&& onSteal) {
+        for (auto& e : entries) {
+            uint32_t expected = Entry::Free;
+            if (e.state.compare_exchange_strong(expected, Entry::Busy)) return &e;
+        }
+
+        for (auto& e : entries) {
+            uint32_t expected = Entry::Active;
+            if (e.state.load() != Entry::Active or !LockOwners::threadIsDead(e.pid)) continue;
+            if (e.state.compare_exchange_strong(expected, Entry::Busy)) {
+                onSteal(e);
+                return &e;
+            }
+        }
+
+        return nullptr;
+    }
+
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <ctime>
 #include <linux/futex.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
@@ -19,6 +20,11 @@ namespace babus {
             return syscall(SYS_futex, this->uaddr, FUTEX_WAIT_BITSET, expectedValue, 0, 0, mask);
         }
 
+        // `deadline` is absolute `CLOCK_MONOTONIC`; null waits forever. Fails with ETIMEDOUT when it passes.
+        inline long waitBitsetUntil(uint32_t expectedValue, uint32_t mask, const timespec* deadline) {
+            return syscall(SYS_futex, this->uaddr, FUTEX_WAIT_BITSET, expectedValue, deadline, 0, mask);
+        }
+
         inline long wakeBitset(uint32_t numToWake, uint32_t mask) {
             return syscall(SYS_futex, this->uaddr, FUTEX_WAKE_BITSET, numToWake, 0, 0, mask);
         }
@@ -27,6 +33,11 @@ namespace babus {
             return syscall(SYS_futex, this->uaddr, FUTEX_WAIT, expectedValue, 0, 0, 0);
         }
 
+        // `timeout` is relative; null waits forever. Fails with ETIMEDOUT when it expires.
+        inline long waitFor(uint32_t expectedValue, const timespec* timeout) {
+            return syscall(SYS_futex, this->uaddr, FUTEX_WAIT, expectedValue, timeout, 0, 0);
+        }
+
         inline long wake(uint32_t numToWake) {
             return syscall(SYS_futex, this->uaddr, FUTEX_WAKE, numToWake, 0, 0, 0);
         }
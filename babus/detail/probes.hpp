@@ -0,0 +1,35 @@
+#pragma once
+
+//
+// USDT (user-level statically defined tracing) probes for perf, bpftrace and systemtap.
+//
+// Built with `-Dusdt=enabled` (which defines `BABUS_USDT`), each `BABUS_PROBE(name, args...)` becomes a
+// `sys/sdt.h` probe `babus:name`: a single nop in the hot path until a tracer attaches, plus a note in the
+// ELF file describing where the arguments live. Without `BABUS_USDT` the macro expands to nothing and the
+// arguments are not evaluated.
+//
+// Probes (string arguments are `const char*`):
+//
+//      babus:slot__write__begin    (name, len)       before taking a slot's write lock
+//      babus:slot__write__locked   (name, len)       write lock acquired
+//      babus:slot__publish         (name, seq, len)  data and seq updated, lock about to be released
+//      babus:slot__write__end      (name, seq)       lock released and waiters woken
+//      babus:lock__acquire         (mutex, isWrite)  `RwMutex` acquired
+//      babus:lock__contend         (mutex, isWrite, value)  about to futex-wait on an `RwMutex`
+//      babus:lock__release         (mutex, isWrite)
+//      babus:futex__wait           (counter, prv, mask)     `SequenceCounter` futex wait
+//      babus:futex__wake           (counter, mask, woken)   `SequenceCounter` futex wake
+//      babus:waiter__wake          (mask, seq)       `Waiter::waitExclusive` returned
+//      babus:waiter__dispatch      (name, seq)       `Waiter::forEachNewSlot` visits a new slot
+//
+// See `scripts/bpftrace/` for examples.
+//
+
+#ifdef BABUS_USDT
+#include <sys/sdt.h>
+#define BABUS_PROBE(name, ...) STAP_PROBEV(babus, name, ##__VA_ARGS__)
+#else
+#define BABUS_PROBE(name, ...) \
+    do {                       \
+    } while (0)
+#endif
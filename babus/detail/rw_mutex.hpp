@@ -2,8 +2,13 @@
 
 #include <atomic>
 #include <cstdint>
+#include <cstdio>
+#include <csignal>
+#include <cstring>
+#include <ctime>
 
 #include <linux/futex.h>
+#include <sys/stat.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -12,6 +17,7 @@
 #include <spdlog/spdlog.h>
 
 #include "futex.hpp"
+#include "probes.hpp"
 
 namespace babus {
 
@@ -38,7 +44,19 @@ namespace babus {
             return value.load(seq_cst);
         }
 
+        // Only a hint -- the answer may be stale by the time the caller looks at it.
+        // Used by optimistic (seqlock-style) readers to validate that no writer was active.
+        inline bool isWriteLocked() {
+            return load() == Locked;
+        }
+
         inline void w_lock() {
+            w_lock(nullptr, []() {});
+        }
+
+        // Like `w_lock()`, but calls `onStall()` after every `stallTimeout` spent asleep, so the caller can check whether the
+        // holder is still alive and repair the lock if not (see `LockOwners`). Null `stallTimeout` never stalls.
+        template <class OnStall> inline void w_lock(const timespec* stallTimeout, OnStall&& onStall) {
             while (1) {
                 auto old  = load();
                 auto old_ = old; // cmpexh actually modifies our `old`
@@ -48,6 +66,7 @@ namespace babus {
                         // The op successfully completed. We've set `nxt`, meaning WE now hold the lock.
                         // This is the only place we can break from the loop.
                         SPDLOG_TRACE("cmpexh completed happy path ({} == {}). Returning without futex wait.", old_, old);
+                        BABUS_PROBE(lock__acquire, this, 1);
                         return;
                     } else {
                         // We've failed the 'happy' path and must use futex wait.
@@ -77,16 +96,19 @@ namespace babus {
 				// NOTE: Just like in r_lock(), the above assertion `old < Unlocked` seems to be wrong
 				//       when there are multiple writers.
 				//       So move it into an if statement instead.
-				// WARNING: But does this create an ABA problem?
-				// WARNING: Or is the if check logic correct -- does this spin?
-				// FIXME: I'm thinking the logic is wrong and this spins when we want to sleep.
+				// NOTE: This used to be `old < Unlocked`, which spun for as long as readers held the lock.
+				//       Readers hold it as `Unlocked + n`, so sleep on anything but `Unlocked`: the last reader out
+				//       wakes one sleeper, and a new reader or writer changing the value makes the wait return EAGAIN.
 
-				if (old < Unlocked) {
+				if (old != Unlocked) {
+					BABUS_PROBE(lock__contend, this, 1, old);
 					FutexView ftx { asPtr() };
-					auto ftxStat = ftx.wait(old);
+					auto ftxStat = ftx.waitFor(old, stallTimeout);
 					if (ftxStat < 0) {
-						if (errno == EAGAIN) {
+						if (errno == EAGAIN or errno == EINTR) {
 							SPDLOG_TRACE("futex got EAGAIN. loop back.");
+						} else if (errno == ETIMEDOUT) {
+							onStall();
 						} else {
 							SPDLOG_ERROR("futex got errno {} ('{}').", errno, strerror(errno));
 							throw std::runtime_error("futex error.");
@@ -100,6 +122,11 @@ namespace babus {
         }
 
         inline void r_lock() {
+            r_lock(nullptr, []() {});
+        }
+
+        // See `w_lock(stallTimeout, onStall)`.
+        template <class OnStall> inline void r_lock(const timespec* stallTimeout, OnStall&& onStall) {
             while (1) {
                 auto old  = load();
                 auto old_ = old; // cmpexh actually modifies our `old`
@@ -108,6 +135,7 @@ namespace babus {
                     if (value.compare_exchange_strong(old, nxt, seq_cst, seq_cst)) {
                         // The op successfully completed. We've set `nxt`, meaning WE now hold the (shared) lock.
                         SPDLOG_TRACE("cmpexh completed happy path ({} == {}). Returning without futex wait.", old_, old);
+                        BABUS_PROBE(lock__acquire, this, 0);
                         return;
                     } else {
                         // We've failed the 'happy' path and must use futex wait.
@@ -140,11 +168,14 @@ namespace babus {
 				//       Think hard about this -- is this logic correct?
 				//
 				if (old < Unlocked) {
+					BABUS_PROBE(lock__contend, this, 0, old);
 					FutexView ftx { asPtr() };
-					auto ftxStat = ftx.wait(old);
+					auto ftxStat = ftx.waitFor(old, stallTimeout);
 					if (ftxStat < 0) {
-						if (errno == EAGAIN) {
+						if (errno == EAGAIN or errno == EINTR) {
 							SPDLOG_TRACE("futex got EAGAIN. loop back.");
+						} else if (errno == ETIMEDOUT) {
+							onStall();
 						} else {
 							SPDLOG_ERROR("futex got errno {} ('{}').", errno, strerror(errno));
 							throw std::runtime_error("futex error.");
@@ -158,6 +189,7 @@ namespace babus {
         }
 
         inline void w_unlock() {
+            BABUS_PROBE(lock__release, this, 1);
             auto old = value.fetch_add(1, seq_cst);
             auto nxt = old + 1;
             assert(old == Locked);
@@ -174,6 +206,7 @@ namespace babus {
         }
 
         inline void r_unlock() {
+            BABUS_PROBE(lock__release, this, 0);
             auto old = value.fetch_sub(1, seq_cst);
             auto nxt = old - 1;
             assert(old > Unlocked);
@@ -192,10 +225,134 @@ namespace babus {
                 }
             }
         }
+
+        // -----------------------------------------------------
+        // Recovery, for when a holder died without unlocking
+        // -----------------------------------------------------
+
+        // Release a write lock taken by someone else. Only call after proving the holder is gone.
+        inline bool breakWriteLock() {
+            uint32_t old = Locked;
+            if (!value.compare_exchange_strong(old, Unlocked, seq_cst, seq_cst)) return false;
+            FutexView { asPtr() }.wake(65536);
+            return true;
+        }
+
+        // Drop `n` read holds taken by someone else. Only call after proving the holders are gone.
+        inline void breakReadLocks(uint32_t n) {
+            auto old = value.fetch_sub(n, seq_cst);
+            assert(old >= Unlocked + n);
+            if (old - n == Unlocked) FutexView { asPtr() }.wake(65536);
+        }
     };
 
     static_assert(sizeof(RwMutex) == 4, "RwMutex must be four bytes");
 
+    //
+    // Who holds a `RwMutex` in shared memory, so a waiter that has slept for a while can tell a slow holder from a
+    // dead one and take the lock back (see `RwMutex::w_lock(stallTimeout, onStall)`). Holders register after locking
+    // and unregister before unlocking. `RwMutexLockGuard` does both when given a `LockOwners`.
+    //
+    // Holds belong to processes, not threads: a guard may move to another thread (a `LockedView` handed to a
+    // `Dispatcher` worker) and outlive the thread that locked. An owner is a pid and the pid namespace it means
+    // something in (see `ownerOf()`). Owners in another namespace, e.g. a container sharing /dev/shm, can not be
+    // checked and count as alive.
+    //
+    // A holder that dies between locking and registering, or that found the reader table full, can not be detected.
+    //
+    struct LockOwners {
+        static constexpr uint32_t MaxReaders = 30;
+
+        std::atomic<uint64_t> writer;
+        std::atomic<uint32_t> writerRecoveries; // Write locks taken back from dead writers.
+        std::atomic<uint32_t> readerRecoveries; // Read locks taken back from dead readers.
+        std::atomic<uint64_t> readers[MaxReaders]; // One entry per read lock held. Zero is free.
+
+        // Not just `kill(tid, 0)`: a dead process stays a zombie until reaped, and that must not block recovery.
+        static inline bool threadIsDead(int32_t tid) {
+            if (kill(tid, 0) != 0) return errno == ESRCH;
+            char path[48], state = 0;
+            snprintf(path, sizeof(path), "/proc/%d/stat", tid);
+            FILE* f = fopen(path, "r");
+            if (f == nullptr) return errno == ENOENT;
+            // The state follows the parenthesized command name, which may contain spaces and parentheses itself.
+            char buf[512];
+            std::size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+            fclose(f);
+            buf[n] = 0;
+            if (const char* close = strrchr(buf, ')'); close and close[1] == ' ') state = close[2];
+            return state == 'Z' or state == 'X';
+        }
+
+        // Identifies this process's pid namespace (the low bits of its inode), or zero if that is unknown.
+        static inline uint32_t pidNamespace() {
+            static const uint32_t ns = [] {
+                struct stat st;
+                return stat("/proc/self/ns/pid", &st) == 0 ? uint32_t(st.st_ino) : 0u;
+            }();
+            return ns;
+        }
+        static inline uint64_t ownerOf(int32_t pid) {
+            return uint64_t(pidNamespace()) << 32 | uint32_t(pid);
+        }
+        static inline bool ownerIsDead(uint64_t owner) {
+            if (uint32_t(owner >> 32) != pidNamespace()) return false;
+            return threadIsDead(int32_t(owner));
+        }
+
+        inline void addWriter(uint64_t owner) {
+            writer.store(owner);
+        }
+        inline void removeWriter() {
+            writer.store(0);
+        }
+
+        inline void addReader(uint64_t owner) {
+            for (uint32_t i = 0; i < MaxReaders; i++) {
+                auto& e       = readers[(uint32_t(owner) + i) % MaxReaders];
+                uint64_t free = 0;
+                if (e.compare_exchange_strong(free, owner)) return;
+            }
+            SPDLOG_DEBUG("LockOwners reader table full, pid {} is not tracked", int32_t(owner));
+        }
+        // Any of the owner's holds: they are interchangeable.
+        inline void removeReader(uint64_t owner) {
+            for (uint32_t i = 0; i < MaxReaders; i++) {
+                auto& e      = readers[(uint32_t(owner) + i) % MaxReaders];
+                uint64_t cur = owner;
+                if (e.compare_exchange_strong(cur, 0)) return;
+            }
+        }
+
+        // Called by a waiter that stalled. Takes back the holds of processes that no longer exist and returns how many.
+        // A dead writer may have left the data half written, so `invalidate(pid)` is called before its lock is released.
+        template <class F> inline uint32_t recoverDeadOwners(RwMutex& mtx, F&& invalidate) {
+            if (mtx.isWriteLocked()) {
+                uint64_t owner = writer.load();
+                // Zero: the writer has not registered yet (or died before it could). Keep waiting.
+                if (owner == 0 or !ownerIsDead(owner)) return 0;
+                if (!writer.compare_exchange_strong(owner, 0)) return 0;
+                invalidate(int32_t(owner));
+                mtx.breakWriteLock();
+                writerRecoveries.fetch_add(1);
+                return 1;
+            }
+
+            uint32_t n = 0;
+            for (auto& e : readers) {
+                uint64_t owner = e.load();
+                if (owner != 0 and ownerIsDead(owner) and e.compare_exchange_strong(owner, 0)) n++;
+            }
+            if (n > 0) {
+                mtx.breakReadLocks(n);
+                readerRecoveries.fetch_add(n);
+            }
+            return n;
+        }
+    };
+
+    static_assert(sizeof(LockOwners) == 256, "LockOwners should stay 256 bytes");
+
     template <bool Write> struct RwMutexLockGuard {
         inline RwMutexLockGuard(RwMutex& m)
             : mtx_(&m) {
@@ -206,25 +363,72 @@ namespace babus {
                 mtx_->r_lock();
 			}
         }
+        // Adopt a lock the caller already took and registered in `owners` as `owner` (see `Slot::getWriteLock()`).
+        inline RwMutexLockGuard(RwMutex& m, LockOwners* owners, uint64_t owner)
+            : mtx_(&m)
+            , owners_(owners)
+            , owner_(owner) {
+        }
         inline ~RwMutexLockGuard() {
+			unlock();
+        }
+
+		// Moving transfers ownership of the lock. Copying would unlock twice.
+        inline RwMutexLockGuard(RwMutexLockGuard&& o)
+            : mtx_(o.mtx_)
+            , owners_(o.owners_)
+            , owner_(o.owner_) {
+			o.mtx_ = nullptr;
+        }
+        RwMutexLockGuard(const RwMutexLockGuard&)            = delete;
+        RwMutexLockGuard& operator=(const RwMutexLockGuard&) = delete;
+        RwMutexLockGuard& operator=(RwMutexLockGuard&&)      = delete;
+
+		// Release early. The destructor then does nothing.
+		inline void unlock() {
 			if (mtx_) {
+				unregister();
 				if constexpr (Write)
 					mtx_->w_unlock();
 				else
 					mtx_->r_unlock();
 			}
-        }
+			mtx_ = nullptr;
+		}
 
 		// This should not be needed except to make the FFI code cleaner.
+		// The lock is no longer tracked by `LockOwners`: whoever unlocks it later may be another thread.
 		inline RwMutex* forgetUnsafe() {
 			// SPDLOG_DEBUG("forgetUnsafe() called -- are you sure you want this?");
+			if (mtx_) unregister();
+			RwMutex* out = mtx_;
+			mtx_ = nullptr;
+			return out;
+		}
+
+		// Like `forgetUnsafe()`, but the hold stays registered in `LockOwners` as `owner()`, so it is still taken back if
+		// this process dies. Whoever unlocks later must unregister it first (see `babus_unlock_view()` in `ffi.cc`).
+		inline RwMutex* releaseTracked() {
 			RwMutex* out = mtx_;
 			mtx_ = nullptr;
 			return out;
 		}
+		inline uint64_t owner() const {
+			return owner_;
+		}
 
 		private:
-        RwMutex* mtx_ = nullptr;
+		inline void unregister() {
+			if (owners_ == nullptr) return;
+			if constexpr (Write)
+				owners_->removeWriter();
+			else
+				owners_->removeReader(owner_);
+		}
+
+        RwMutex* mtx_       = nullptr;
+        LockOwners* owners_ = nullptr;
+        uint64_t owner_     = 0;
     };
 
     using RwMutexWriteLockGuard = RwMutexLockGuard<true>;
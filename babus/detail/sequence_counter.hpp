@@ -12,6 +12,7 @@
 #include <spdlog/spdlog.h>
 
 #include "futex.hpp"
+#include "probes.hpp"
 
 namespace babus {
 
@@ -45,6 +46,7 @@ namespace babus {
 
             FutexView ftx(asPtr());
             auto stat = ftx.wakeBitset(65536, mask);
+            BABUS_PROBE(futex__wake, this, mask, stat);
             if (stat < 0) {
                 SPDLOG_ERROR("futex.wakeBitset errno {} ('{}')", errno, strerror(errno));
             } else {
@@ -56,6 +58,22 @@ namespace babus {
 
         // Wait for the value to change, then return the old value.
         inline uint32_t waitForChange(uint32_t prv, uint32_t mask) {
+            return waitForChangeUntil(prv, mask, nullptr);
+        }
+
+        // Like `waitForChange`, but gives up after `timeoutNanos`. For threads that must also notice something
+        // process-local (like being stopped) without another thread bumping this shared counter to wake them.
+        inline uint32_t waitForChangeFor(uint32_t prv, uint32_t mask, int64_t timeoutNanos) {
+            timespec deadline;
+            clock_gettime(CLOCK_MONOTONIC, &deadline);
+            int64_t nanos     = deadline.tv_nsec + timeoutNanos;
+            deadline.tv_sec  += nanos / 1'000'000'000;
+            deadline.tv_nsec  = nanos % 1'000'000'000;
+            return waitForChangeUntil(prv, mask, &deadline);
+        }
+
+    private:
+        inline uint32_t waitForChangeUntil(uint32_t prv, uint32_t mask, const timespec* deadline) {
             uint32_t cur = load();
 
             if (cur != prv) {
@@ -63,13 +81,14 @@ namespace babus {
                 return cur;
             }
 
+            BABUS_PROBE(futex__wait, this, prv, mask);
             FutexView ftx(asPtr());
             // SPDLOG_TRACE("futex.waitBitset ftx 0x{:0x}", (std::size_t)asPtr());
-            auto stat = ftx.waitBitset(cur, mask);
+            auto stat = ftx.waitBitsetUntil(cur, mask, deadline);
 
             if (stat < 0) {
-                if (errno == EAGAIN) {
-                    SPDLOG_TRACE("futex.waitBitset returned EAGAIN. This is not an error.");
+                if (errno == EAGAIN or errno == ETIMEDOUT or errno == EINTR) {
+                    SPDLOG_TRACE("futex.waitBitset returned errno {}. This is not an error.", errno);
                 } else {
                     SPDLOG_ERROR("futex.waitBitset errno {} ('{}')", errno, strerror(errno));
                 }
@@ -0,0 +1,155 @@
+#include "dispatcher.h"
+
+namespace babus {
+
+    Dispatcher::Dispatcher(Domain* domain, uint32_t numWorkers)
+        : domain_(domain)
+        , waiter_(domain) {
+        assert(numWorkers > 0);
+        for (uint32_t i = 0; i < numWorkers; i++) workers_.push_back(std::make_unique<Worker>());
+    }
+
+    Dispatcher::~Dispatcher() {
+        stop();
+    }
+
+    void Dispatcher::subscribeTo(Slot* slot, Handler handler, bool wakeWith) {
+        assert(!waitThread_.joinable() && "subscribeTo() must be called before start()");
+        waiter_.subscribeTo(slot, wakeWith);
+
+        auto strand     = std::make_unique<Strand>();
+        strand->slot    = slot;
+        strand->handler = std::move(handler);
+        strands_.push_back(std::move(strand));
+    }
+
+    void Dispatcher::start() {
+        stop_        = false;
+        workersStop_ = false;
+        for (uint32_t i = 0; i < workers_.size(); i++) workers_[i]->thread = std::thread(&Dispatcher::workerLoop, this, i);
+        waitThread_ = std::thread(&Dispatcher::waitLoop, this);
+    }
+
+    void Dispatcher::stop() {
+        if (!waitThread_.joinable()) return;
+
+        // The waiting thread notices within `StopCheckNanos`. Waking it through the shared counter would wake
+        // other processes subscribed to the same bits too.
+        stop_ = true;
+        waitThread_.join();
+
+        {
+            std::lock_guard<std::mutex> lck(idleMtx_);
+            workersStop_ = true;
+            idleCv_.notify_all();
+        }
+        for (auto& w : workers_) w->thread.join();
+    }
+
+    Dispatcher::Stats Dispatcher::stats() const {
+        Stats s;
+        s.dispatched = dispatched_.load();
+        s.stolen     = stolen_.load();
+        return s;
+    }
+
+    Dispatcher::Strand* Dispatcher::findStrand(Slot* slot) {
+        for (auto& s : strands_)
+            if (s->slot == slot) return s.get();
+        return nullptr;
+    }
+
+    void Dispatcher::enqueue(Strand* strand, LockedView&& view) {
+        bool needsSchedule = false;
+        {
+            std::lock_guard<std::mutex> lck(strand->mtx);
+            strand->queue.push_back(std::move(view));
+            if (!strand->scheduled) needsSchedule = strand->scheduled = true;
+        }
+        if (needsSchedule) schedule(strand, nextWorker_++ % workers_.size());
+    }
+
+    void Dispatcher::schedule(Strand* strand, uint32_t workerIndex) {
+        // Holding `idleMtx_` while pushing means a sleeping worker never sees a count without a strand.
+        std::lock_guard<std::mutex> lck(idleMtx_);
+        {
+            std::lock_guard<std::mutex> wlck(workers_[workerIndex]->mtx);
+            workers_[workerIndex]->strands.push_back(strand);
+        }
+        numQueued_++;
+        idleCv_.notify_one();
+    }
+
+    Dispatcher::Strand* Dispatcher::popOrSteal(uint32_t workerIndex) {
+        uint32_t n = workers_.size();
+        for (uint32_t k = 0; k < n; k++) {
+            Worker& w = *workers_[(workerIndex + k) % n];
+            std::lock_guard<std::mutex> lck(w.mtx);
+            if (w.strands.empty()) continue;
+
+            // Own deque from the back (most recently re-queued, likely cache-warm), victims from the front.
+            Strand* strand;
+            if (k == 0) {
+                strand = w.strands.back();
+                w.strands.pop_back();
+            } else {
+                strand = w.strands.front();
+                w.strands.pop_front();
+                stolen_++;
+            }
+            numQueued_--;
+            return strand;
+        }
+        return nullptr;
+    }
+
+    void Dispatcher::runStrand(Strand* strand, uint32_t workerIndex) {
+        std::unique_lock<std::mutex> lck(strand->mtx);
+        LockedView view = std::move(strand->queue.front());
+        strand->queue.pop_front();
+        lck.unlock();
+
+        strand->handler(std::move(view));
+        dispatched_++;
+
+        lck.lock();
+        if (strand->queue.empty()) {
+            strand->scheduled = false;
+        } else {
+            lck.unlock();
+            schedule(strand, workerIndex);
+        }
+    }
+
+    void Dispatcher::waitLoop() {
+        uint32_t mask = waiter_.waitMask();
+        while (true) {
+            // Sample the counter before checking `stop_` and the slots: anything that happens after
+            // this point (including `stop()`) makes the futex wait below return immediately.
+            uint32_t prv = domain_->seq.load();
+            if (stop_) break;
+
+            waiter_.forEachNewSlot([&](LockedView&& view) {
+                Strand* strand = findStrand(view.slot);
+                assert(strand != nullptr);
+                enqueue(strand, std::move(view));
+            });
+
+            domain_->seq.waitForChangeFor(prv, mask, StopCheckNanos);
+        }
+    }
+
+    void Dispatcher::workerLoop(uint32_t workerIndex) {
+        while (true) {
+            if (Strand* strand = popOrSteal(workerIndex)) {
+                runStrand(strand, workerIndex);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lck(idleMtx_);
+            idleCv_.wait(lck, [&]() { return numQueued_.load() > 0 or workersStop_; });
+            if (numQueued_.load() <= 0 and workersStop_) return;
+        }
+    }
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include "waiter.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace babus {
+
+    //
+    // `Dispatcher` owns a thread blocked in `Waiter::waitExclusive` and hands slot callbacks to a small
+    // work-stealing thread pool, so a slow handler for one slot (a 20 ms image) does not delay another (IMU).
+    //
+    // Each subscribed slot is a "strand": its callbacks run in order and never concurrently. Callbacks of
+    // different slots run in parallel. A strand with work sits in exactly one worker's deque; workers pop
+    // their own deque and steal from the others' when idle.
+    //
+    // The handler receives the `LockedView`, which stays alive until the handler returns. It holds the read
+    // lock, so writers of that slot block until then: a handler that works on the data for long should
+    // `cloneBytes()` and let the view go.
+    //
+    // NOTE: Like `Waiter`, the `Domain` and `Slot`s must outlive the `Dispatcher`.
+    //
+
+    class Dispatcher {
+    public:
+        using Handler = std::function<void(LockedView&&)>;
+
+        Dispatcher(Domain* domain, uint32_t numWorkers = 2);
+        ~Dispatcher();
+        Dispatcher(const Dispatcher&)            = delete;
+        Dispatcher& operator=(const Dispatcher&) = delete;
+
+        // Must be called before `start()`.
+        void subscribeTo(Slot* slot, Handler handler, bool wakeWith = true);
+
+        void start();
+
+        // Stops the waiting thread (within `StopCheckNanos`), lets queued callbacks finish, and joins all threads.
+        void stop();
+
+        struct Stats {
+            uint64_t dispatched = 0;
+            uint64_t stolen     = 0;
+        };
+        Stats stats() const;
+
+    private:
+        struct Strand {
+            Slot* slot;
+            Handler handler;
+
+            std::mutex mtx;
+            std::deque<LockedView> queue;
+            bool scheduled = false;
+        };
+
+        struct Worker {
+            std::mutex mtx;
+            std::deque<Strand*> strands;
+            std::thread thread;
+        };
+
+        Domain* domain_;
+        Waiter waiter_;
+        std::vector<std::unique_ptr<Strand>> strands_;
+        std::vector<std::unique_ptr<Worker>> workers_;
+        std::thread waitThread_;
+
+        std::atomic<bool> stop_ { false };
+        std::atomic<uint32_t> nextWorker_ { 0 };
+
+        // Workers with nothing to pop or steal sleep here.
+        std::mutex idleMtx_;
+        std::condition_variable idleCv_;
+        std::atomic<int32_t> numQueued_ { 0 };
+        bool workersStop_ = false; // Guarded by `idleMtx_`. Set once the waiting thread has exited.
+
+        std::atomic<uint64_t> dispatched_ { 0 };
+        std::atomic<uint64_t> stolen_ { 0 };
+
+        Strand* findStrand(Slot* slot);
+        void enqueue(Strand* strand, LockedView&& view);
+        void schedule(Strand* strand, uint32_t workerIndex);
+        Strand* popOrSteal(uint32_t workerIndex);
+        void runStrand(Strand* strand, uint32_t workerIndex);
+
+        void waitLoop();
+        void workerLoop(uint32_t workerIndex);
+    };
+
+}
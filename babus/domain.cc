@@ -1,8 +1,97 @@
 #include "domain.h"
 
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
 namespace babus {
 
     namespace { }
+
+    uint32_t Domain::registerSlot(const char* slotName) {
+        auto lck { getSlotsWriteLock() };
+
+        uint32_t freeIndex = numSlots;
+        for (uint32_t i = 0; i < numSlots; i++) {
+            if (strncmp(slotNames[i], slotName, MaxNameLength) == 0) return i;
+            if (slotNames[i][0] == 0 and freeIndex == numSlots) freeIndex = i;
+        }
+
+        if (freeIndex >= MaxSlots) {
+            SPDLOG_WARN("slot registry is full ({} slots), slot '{}' is not registered and shares a futex bit", MaxSlots, slotName);
+            return UnregisteredSlotIndex;
+        }
+
+        strncpy(slotNames[freeIndex], slotName, MaxNameLength - 1);
+        SPDLOG_DEBUG("registered slot '{}' with index {}", slotName, freeIndex);
+        if (freeIndex == numSlots) numSlots++;
+        return freeIndex;
+    }
+
+    void Domain::unregisterSlot(const char* slotName) {
+        auto lck { getSlotsWriteLock() };
+
+        // Re-created since its file was removed: the new slot uses the entry.
+        if (access((std::string { Prefix } + slotName).c_str(), F_OK) == 0) return;
+
+        for (uint32_t i = 0; i < numSlots; i++) {
+            if (strncmp(slotNames[i], slotName, MaxNameLength) != 0) continue;
+            memset(slotNames[i], 0, MaxNameLength);
+            while (numSlots > 0 and slotNames[numSlots - 1][0] == 0) numSlots--;
+            SPDLOG_DEBUG("unregistered slot '{}' with index {}", slotName, i);
+            return;
+        }
+    }
+
+    void Domain::recoverSlotsLock() {
+        uint32_t n = slotMtxOwners.recoverDeadOwners(slotMtx, [](int32_t pid) {
+            SPDLOG_WARN("writer pid {} died holding the slot registry lock", pid);
+        });
+        if (n > 0) SPDLOG_WARN("domain '{}': took back {} slot registry lock hold(s) from dead processes", name, n);
+    }
+
+    void Slot::recoverLock() {
+        uint32_t n = lockOwners().recoverDeadOwners(mtx, [this](int32_t pid) {
+            SPDLOG_WARN("slot '{}': writer pid {} died holding the lock, invalidating its data", name, pid);
+            length = 0;
+            flags.bits |= SlotFlags::Invalid;
+        });
+        if (n > 0) SPDLOG_WARN("slot '{}': took back {} lock hold(s) from dead processes", name, n);
+    }
+
+    void Slot::releaseBeyond(std::size_t keep) {
+        const uintptr_t page = sysconf(_SC_PAGESIZE);
+        uintptr_t base       = reinterpret_cast<uintptr_t>(data_ptr());
+        uintptr_t from       = (base + keep + page - 1) & ~(page - 1);
+        uintptr_t to         = (base + highWater) & ~(page - 1);
+        if (to > from) {
+            // MADV_REMOVE frees tmpfs pages for every process mapping the file. It fails with EINVAL on private memory
+            // (malloc'd test slots), where MADV_DONTNEED has the same effect. On a shared mapping MADV_DONTNEED would
+            // only drop this process's page table entries and free nothing, so any other failure leaves the
+            // accounting alone and the next window tries again.
+            void* addr  = reinterpret_cast<void*>(from);
+            bool failed = madvise(addr, to - from, MADV_REMOVE) != 0;
+            if (failed and errno == EINVAL) failed = madvise(addr, to - from, MADV_DONTNEED) != 0;
+            if (failed) {
+                SPDLOG_WARN("slot '{}': releasing {} bytes failed with errno {} ('{}')", name, to - from, errno, strerror(errno));
+                return;
+            }
+            trimmedBytes += to - from;
+            SPDLOG_DEBUG("slot '{}': released {} bytes beyond {}", name, to - from, keep);
+        }
+        highWater = keep;
+    }
+
+    std::size_t Slot::residentBytes(std::size_t mappedSize) const {
+        const std::size_t page = sysconf(_SC_PAGESIZE);
+        uintptr_t base         = reinterpret_cast<uintptr_t>(this);
+        if (base % page != 0) return 0;
+        std::vector<unsigned char> vec((mappedSize + page - 1) / page);
+        if (mincore(const_cast<Slot*>(this), mappedSize, vec.data()) != 0) return 0;
+        std::size_t n = 0;
+        for (unsigned char v : vec) n += v & 1;
+        return n * page;
+    }
 }
 
 namespace fmt {
@@ -1,12 +1,23 @@
 #pragma once
 
+#include "attach.h"
 #include "babus/common.h"
+#include "consumers.h"
+#include "copy.h"
 #include "detail/rw_mutex.hpp"
 #include "detail/sequence_counter.hpp"
 #include "detail/small_map.hpp"
 #include "fs/mmap.h"
+#include "image.h"
+#include "pollfd.h"
+#include "stats.h"
+#include "trace.h"
 
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
 #include <mutex>
+#include <vector>
 
 #include <spdlog/spdlog.h>
 
@@ -27,6 +38,12 @@ namespace babus {
         }
     };
 
+    // Where `LockedView::readv` copies one range of a message to.
+    struct ReadRange {
+        std::size_t offset = 0; // Into the message.
+        ByteSpan dst;           // Receives `dst.len` bytes, fewer if the message ends first.
+    };
+
     struct Slot;
 
     struct LockedView {
@@ -34,25 +51,80 @@ namespace babus {
         RwMutexReadLockGuard lck;
         Slot* slot = nullptr;
 
+        // When and by whom the viewed data was published. See `Slot::publishNanos`.
+        int64_t publishNanos = 0;
+        int32_t publisherPid = 0;
+
+        // The last writer died holding the lock, so there is no valid data (`span` is empty) until the next write.
+        bool invalidated = false;
+
+        // Set if the data was published as an image. See `image.h`.
+        ImageLayout image;
+
         inline std::vector<uint8_t> cloneBytes() const {
             std::vector<uint8_t> out;
             out.resize(span.len);
-            memcpy(out.data(), span.ptr, span.len);
+            copyBytes(out.data(), span.ptr, span.len);
             return out;
         }
+
+        inline ImageView imageView() const {
+            return ImageView { reinterpret_cast<const uint8_t*>(span.ptr), span.len, image };
+        }
+
+        // Copy several ranges of the message out in one go, e.g. a header into a struct and a plane into an existing
+        // buffer, without cloning the whole message first. Returns the bytes copied.
+        inline std::size_t readv(std::initializer_list<ReadRange> ranges) const {
+            std::size_t total = 0;
+            for (const ReadRange& r : ranges) {
+                if (r.offset >= span.len) continue;
+                std::size_t n = std::min(r.dst.len, span.len - r.offset);
+                copyBytes(r.dst.ptr, reinterpret_cast<const uint8_t*>(span.ptr) + r.offset, n);
+                total += n;
+            }
+            return total;
+        }
+    };
+
+    struct Domain;
+
+    //
+    // Write directly into a slot's memory instead of copying from a temporary buffer.
+    // The write lock is held from `Slot::beginWrite()` until `commit()`, which publishes the first `len`
+    // bytes of `span` (sets the length, bumps the sequence counter and wakes waiters).
+    // Destroying an uncommitted `WriteView` releases the lock without publishing anything.
+    //
+    struct WriteView {
+        ByteSpan span; // The slot's whole data capacity.
+        RwMutexWriteLockGuard lck;
+        Slot* slot  = nullptr;
+        Domain* dom = nullptr;
+
+        // Published with the data. Leave it default for data that is not an image.
+        ImageLayout image;
+
+        // Only set with `BABUS_SLOT_STATS`.
+        int64_t lockRequestedNanos = 0;
+        int64_t lockAcquiredNanos  = 0;
+
+        inline void commit(std::size_t len);
     };
 
     struct SlotFlags {
+        // Set when a writer died mid-write and its lock was taken back. Cleared by the next publish.
+        static constexpr uint64_t Invalid = 1;
+        // Never removed by `ClientDomain::sweepOrphanSlots()`. Set by `babusctl create`.
+        static constexpr uint64_t Persistent = 2;
+
         uint64_t bits = 0;
     };
 
-    struct Domain;
-
     struct Slot {
     public:
         std::array<char, 4> magic = SlotMagic;
+        uint32_t layoutVersion    = SlotLayoutVersion;
         RwMutex mtx;
-        uint32_t index = 0; // Used for event futex mask.
+        uint32_t index = 0; // Position in the `Domain` slot registry. Used for event futex mask.
         SequenceCounter seq;
 
         // Using a ring-buffer is more complicated than I realized because it requires
@@ -66,54 +138,312 @@ namespace babus {
         // std::array<uint32_t, SlotMaxRingLength> length = {0}; // current data length
         uint32_t length = 0; // current data length
 
+        // Set by every write while it holds the write lock, so readers get end-to-end latency without
+        // putting a timestamp in the payload. `CLOCK_MONOTONIC` nanoseconds (see `monotonicNanos()`).
+        int32_t publisherPid = 0;
+        int64_t publishNanos = 0;
+
         SlotFlags flags;
         char name[MaxNameLength] = { 0 };
 
+        // Memory accounting. A write of a big message leaves its pages resident after later, smaller writes, so writers
+        // track the largest length and release the pages beyond it once messages stayed smaller for `trimAfterNanos`
+        // (zero never releases). See `trackLength()`. All written under the write lock.
+        uint32_t highWater           = 0; // Largest length since pages were last released: what may be resident.
+        uint32_t recentPeak          = 0; // Largest length in the current window.
+        int64_t recentPeakSinceNanos = 0; // Start of the current window.
+        int64_t trimAfterNanos       = SlotTrimAfterNanos;
+        uint64_t trimmedBytes        = 0; // Total bytes released.
+
+        // Recorded by the first `TypedSlot<T>` to attach (see `typed.h`). Zero for byte slots.
+        std::atomic<uint64_t> typeHash { 0 };
+        uint32_t typeSize = 0;
+
+        // How the current data is laid out if it was published as an image (see `image.h`). Set by every publish.
+        ImageLayout image;
+
+        // False for files that are not slots, or were made by a build with a different layout.
+        inline bool hasCurrentLayout() const {
+            return magic == SlotMagic and layoutVersion == SlotLayoutVersion;
+        }
+
         inline uint8_t* data_ptr() {
             return reinterpret_cast<uint8_t*>(this) + SlotDataOffset;
         }
         inline const uint8_t* data_ptr() const {
             return reinterpret_cast<const uint8_t*>(this) + SlotDataOffset;
         }
+
+        // How long a lock waiter sleeps before checking whether the holder died. See `recoverLock()`.
+        static constexpr timespec LockStallTimeout = { 0, 100'000'000 };
+
+        // The lock is tracked in `lockOwners()`, so a process dying while holding it does not wedge the slot.
         inline RwMutexWriteLockGuard getWriteLock() {
-            return RwMutexWriteLockGuard { mtx };
+            mtx.w_lock(&LockStallTimeout, [this]() { recoverLock(); });
+            uint64_t owner = LockOwners::ownerOf(traceThreadIds().pid);
+            lockOwners().addWriter(owner);
+            return RwMutexWriteLockGuard { mtx, &lockOwners(), owner };
         }
         inline RwMutexReadLockGuard getReadLock() {
-            return RwMutexReadLockGuard { mtx };
+            mtx.r_lock(&LockStallTimeout, [this]() { recoverLock(); });
+            uint64_t owner = LockOwners::ownerOf(traceThreadIds().pid);
+            lockOwners().addReader(owner);
+            return RwMutexReadLockGuard { mtx, &lockOwners(), owner };
+        }
+        inline LockOwners& lockOwners() {
+            return *reinterpret_cast<LockOwners*>(reinterpret_cast<uint8_t*>(this) + SlotLockOwnersOffset);
+        }
+        inline const LockOwners& lockOwners() const {
+            return *reinterpret_cast<const LockOwners*>(reinterpret_cast<const uint8_t*>(this) + SlotLockOwnersOffset);
+        }
+        // Called by a lock waiter that stalled: takes back holds of dead processes. If that was the writer, the data may be
+        // torn, so the slot is emptied and flagged `SlotFlags::Invalid` until the next write.
+        void recoverLock();
+        // The futex bitset bit of this slot. Slots beyond the 32nd alias onto lower bits, and slots that did not fit in
+        // the registry (`UnregisteredSlotIndex`) share bit 0.
+        inline uint32_t eventMask() const {
+            return 1u << (index % 32);
         }
+        inline SlotStats& stats() {
+            return *reinterpret_cast<SlotStats*>(reinterpret_cast<uint8_t*>(this) + SlotStatsOffset);
+        }
+        inline const SlotStats& stats() const {
+            return *reinterpret_cast<const SlotStats*>(reinterpret_cast<const uint8_t*>(this) + SlotStatsOffset);
+        }
+        inline AttachTable& attachments() {
+            return *reinterpret_cast<AttachTable*>(reinterpret_cast<uint8_t*>(this) + SlotAttachOffset);
+        }
+        inline const AttachTable& attachments() const {
+            return *reinterpret_cast<const AttachTable*>(reinterpret_cast<const uint8_t*>(this) + SlotAttachOffset);
+        }
+        inline ConsumerTable& consumers() {
+            return *reinterpret_cast<ConsumerTable*>(reinterpret_cast<uint8_t*>(this) + SlotConsumersOffset);
+        }
+        inline const ConsumerTable& consumers() const {
+            return *reinterpret_cast<const ConsumerTable*>(reinterpret_cast<const uint8_t*>(this) + SlotConsumersOffset);
+        }
+
+        // Called by writers right before releasing the write lock. No-op without `BABUS_SLOT_STATS`.
+        inline void recordWrite(int64_t lockRequestedNanos, int64_t lockAcquiredNanos, std::size_t len) {
+            if constexpr (SlotStatsEnabled) {
+                constexpr auto relaxed = std::memory_order_relaxed;
+                int64_t now            = monotonicNanos();
+                SlotStats& s           = stats();
+                s.writes.fetch_add(1, relaxed);
+                s.bytesWritten.fetch_add(len, relaxed);
+                s.writeLockWaitNanos.record(lockAcquiredNanos - lockRequestedNanos);
+                s.writeLockHoldNanos.record(now - lockAcquiredNanos);
+                s.lastPublishNanos.store(now, relaxed);
+            }
+        }
+
+        // Called by writers under the write lock, after the data and `length` are in place.
+        inline void stampPublish() {
+            publisherPid = traceThreadIds().pid;
+            publishNanos = monotonicNanos();
+            flags.bits &= ~SlotFlags::Invalid;
+            trackLength();
+        }
+
+        // Called by `stampPublish()`. Every `trimAfterNanos`, releases the pages between the window's peak and the
+        // high-water mark, so a slot that once carried a big message does not keep it resident forever.
+        inline void trackLength() {
+            if (length > highWater) highWater = length;
+            if (length > recentPeak) recentPeak = length;
+            if (trimAfterNanos <= 0 or publishNanos - recentPeakSinceNanos < trimAfterNanos) return;
+            if (highWater - recentPeak >= SlotTrimMinBytes) releaseBeyond(recentPeak);
+            recentPeak           = length;
+            recentPeakSinceNanos = publishNanos;
+        }
+
+        // Give the data pages beyond `keep` bytes back to the kernel and lower the high-water mark. Under the write lock.
+        void releaseBeyond(std::size_t keep);
+
+        // Bytes of this slot's file (header included) currently in memory, from `mincore()` on this mapping.
+        std::size_t residentBytes(std::size_t mappedSize = SlotFileSize) const;
+
         inline LockedView read() {
-            return LockedView {
-                ByteSpan { data_ptr(), length },
-                 getReadLock(), this
-            };
+            if constexpr (SlotStatsEnabled) stats().reads.fetch_add(1, std::memory_order_relaxed);
+            LockedView out { {}, getReadLock(), this };
+            // Only read the header once the lock is held.
+            out.span         = ByteSpan { data_ptr(), length };
+            out.publishNanos = publishNanos;
+            out.publisherPid = publisherPid;
+            out.invalidated  = flags.bits & SlotFlags::Invalid;
+            out.image        = image;
+            return out;
         }
 
-        void write(Domain* dom, ByteSpan span);
+        inline void write(Domain* dom, ByteSpan span) {
+            writev(dom, &span, 1);
+        }
+
+        // Write a message made of several pieces (e.g. header + image plane + metadata), concatenated in the slot under
+        // one lock and with one wakeup. Saves assembling them in a temporary buffer first.
+        void writev(Domain* dom, const ByteSpan* pieces, std::size_t numPieces);
+        inline void writev(Domain* dom, std::initializer_list<ByteSpan> pieces) {
+            writev(dom, pieces.begin(), pieces.size());
+        }
+
+        // Publish `pixels` (`layout.byteSize()` bytes of it) as an image. Readers see `layout` in `LockedView::image`.
+        inline void writeImage(Domain* dom, const ImageLayout& layout, ByteSpan pixels);
+
+        inline WriteView beginWrite(Domain* dom);
+
+        // Wake waiters and pollers of this slot. Called by writers *after* releasing the write lock.
+        inline void notify(Domain* dom);
     };
 
-    static_assert(sizeof(Slot) < SlotDataOffset, "Slot type too large for SlotDataOffset");
+    static_assert(sizeof(Slot) < SlotStatsOffset, "Slot type too large for SlotStatsOffset");
+    static_assert(SlotLockOwnersOffset + sizeof(LockOwners) <= SlotDataOffset, "LockOwners does not fit before SlotDataOffset");
 
     struct Domain {
 
     public:
         std::array<char, 4> magic = DomainMagic;
-        RwMutex slotMtx; // actually I don't think I need this.
+        uint32_t layoutVersion    = DomainLayoutVersion;
+        RwMutex slotMtx; // Guards the slot registry below. Take it with `getSlotsWriteLock()`/`getSlotsReadLock()`.
         SequenceCounter seq;
         std::size_t slotFileSizes;
         char name[MaxNameLength] = { 0 };
-        Slot slots[64];
+
+        // Registry of the domain's slots. A slot's position here is its `Slot::index`, which
+        // makes futex masks stable across processes and lets tools enumerate a domain.
+        // Entries of removed slots are empty names, reused by later registrations. Enumerators skip them.
+        uint32_t numSlots                       = 0;
+        char slotNames[MaxSlots][MaxNameLength] = {};
+        LockOwners slotMtxOwners;
+
+        PollerTable pollers;
+
+        // False for files that are not domains, or were made by a build with a different layout.
+        inline bool hasCurrentLayout() const {
+            return magic == DomainMagic and layoutVersion == DomainLayoutVersion;
+        }
+
+        // Find or add `slotName`, returning its index. If the registry is full the slot still works, but gets
+        // `UnregisteredSlotIndex`: it shares a futex bit with other slots and tools do not list it.
+        uint32_t registerSlot(const char* slotName);
+        // Free the entry of a slot whose file was removed, unless the file exists again.
+        void unregisterSlot(const char* slotName);
+
+        // Like `Slot::getWriteLock()`: a process dying while it holds `slotMtx` does not wedge the registry.
+        inline RwMutexWriteLockGuard getSlotsWriteLock() {
+            slotMtx.w_lock(&Slot::LockStallTimeout, [this]() { recoverSlotsLock(); });
+            uint64_t owner = LockOwners::ownerOf(traceThreadIds().pid);
+            slotMtxOwners.addWriter(owner);
+            return RwMutexWriteLockGuard { slotMtx, &slotMtxOwners, owner };
+        }
+        inline RwMutexReadLockGuard getSlotsReadLock() {
+            slotMtx.r_lock(&Slot::LockStallTimeout, [this]() { recoverSlotsLock(); });
+            uint64_t owner = LockOwners::ownerOf(traceThreadIds().pid);
+            slotMtxOwners.addReader(owner);
+            return RwMutexReadLockGuard { slotMtx, &slotMtxOwners, owner };
+        }
+        // Called by a `slotMtx` waiter that stalled. A dead writer can at most have left a half-copied name past
+        // `numSlots`, which the next registration overwrites, so nothing needs invalidating.
+        void recoverSlotsLock();
+
+        inline void notifyPollers(uint32_t mask) {
+            if (pollers.numActive.load(std::memory_order_relaxed) != 0) pollers.notify(mask);
+        }
+
+        // The domain-wide event trace, stored after this header in the domain file. See `trace.h`.
+        inline TraceRing& trace() {
+            return *reinterpret_cast<TraceRing*>(reinterpret_cast<uint8_t*>(this) + DomainTraceOffset);
+        }
+        inline void traceEvent(TraceEvent event, uint8_t slot, uint32_t seq, uint32_t arg) {
+            TraceRing& ring = trace();
+            if (ring.isEnabled()) ring.append(event, slot, seq, arg);
+        }
+        // Timestamp to pass to `traceWriteLock()` once the lock is held, or zero if tracing is off.
+        inline uint64_t traceLockRequested() {
+            return trace().isEnabled() ? traceTicks() : 0;
+        }
+        inline void traceWriteLock(const Slot* slot, uint64_t requestedTicks) {
+            if (requestedTicks == 0) return;
+            uint64_t waited = traceTicks() - requestedTicks;
+            traceEvent(TraceEvent::WriteLock, slot->index, slot->seq.load(), waited > UINT32_MAX ? UINT32_MAX : uint32_t(waited));
+        }
     };
 
-    inline void Slot::write(Domain* dom, ByteSpan span) {
-        assert(span.len < SlotFileSize - SlotDataOffset);
+    static_assert(sizeof(Domain) <= DomainTraceOffset, "Domain type too large for DomainTraceOffset");
+
+    inline void Slot::notify(Domain* dom) {
+        if constexpr (SlotStatsEnabled) stats().futexWakes.fetch_add(1, std::memory_order_relaxed);
+        dom->traceEvent(TraceEvent::Publish, index, seq.load(), length);
+        dom->seq.increment(eventMask());
+        dom->notifyPollers(eventMask());
+    }
+
+    inline void Slot::writev(Domain* dom, const ByteSpan* pieces, std::size_t numPieces) {
+        std::size_t len = 0;
+        for (std::size_t i = 0; i < numPieces; i++) len += pieces[i].len;
+        assert(len < SlotDataCapacity);
+        BABUS_PROBE(slot__write__begin, name, len);
+        int64_t requested       = SlotStatsEnabled ? monotonicNanos() : 0;
+        uint64_t requestedTicks = dom->traceLockRequested();
         {
             auto lck { getWriteLock() };
-            std::memcpy(data_ptr(), span.ptr, span.len);
-            length = span.len;
+            BABUS_PROBE(slot__write__locked, name, len);
+            int64_t acquired = SlotStatsEnabled ? monotonicNanos() : 0;
+            dom->traceWriteLock(this, requestedTicks);
+            uint8_t* dst = data_ptr();
+            for (std::size_t i = 0; i < numPieces; i++) {
+                copyBytes(dst, pieces[i].ptr, pieces[i].len);
+                dst += pieces[i].len;
+            }
+            length = len;
+            image  = ImageLayout {};
+            stampPublish();
             seq.incrementNoFutexWake();
+            recordWrite(requested, acquired, len);
+            BABUS_PROBE(slot__publish, name, seq.load(), len);
+        }
+        SPDLOG_TRACE("Slot::writev() wrote n={} in {} pieces to 0x{:0x}", len, numPieces, (std::size_t)data_ptr());
+        notify(dom);
+        BABUS_PROBE(slot__write__end, name, seq.load());
+    }
+
+    inline WriteView Slot::beginWrite(Domain* dom) {
+        BABUS_PROBE(slot__write__begin, name, 0);
+        int64_t requested       = SlotStatsEnabled ? monotonicNanos() : 0;
+        uint64_t requestedTicks = dom->traceLockRequested();
+        WriteView out {
+            ByteSpan { data_ptr(), SlotDataCapacity },
+            getWriteLock(), this, dom
+        };
+        if constexpr (SlotStatsEnabled) {
+            out.lockRequestedNanos = requested;
+            out.lockAcquiredNanos  = monotonicNanos();
         }
-        SPDLOG_TRACE("Slot::write() wrote n={} to 0x{:0x}", span.len, (std::size_t)data_ptr());
-        dom->seq.increment(1u << index);
+        dom->traceWriteLock(this, requestedTicks);
+        BABUS_PROBE(slot__write__locked, name, 0);
+        return out;
+    }
+
+    inline void Slot::writeImage(Domain* dom, const ImageLayout& layout, ByteSpan pixels) {
+        std::size_t len = layout.byteSize();
+        assert(len <= pixels.len and len <= SlotDataCapacity);
+        auto wv  = beginWrite(dom);
+        wv.image = layout;
+        copyBytes(wv.span.ptr, pixels.ptr, len);
+        wv.commit(len);
+    }
+
+    inline void WriteView::commit(std::size_t len) {
+        assert(len <= span.len);
+        assert(slot != nullptr);
+        slot->length = len;
+        slot->image  = image;
+        slot->stampPublish();
+        slot->seq.incrementNoFutexWake();
+        slot->recordWrite(lockRequestedNanos, lockAcquiredNanos, len);
+        BABUS_PROBE(slot__publish, slot->name, slot->seq.load(), len);
+        lck.unlock();
+        slot->notify(dom);
+        BABUS_PROBE(slot__write__end, slot->name, slot->seq.load());
+        slot = nullptr;
     }
 
 } // namespace babus
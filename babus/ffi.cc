@@ -10,8 +10,22 @@ struct C_LockedView {
     size_t len;
     RwMutex* mtx;
     Slot* slot;
+    uint64_t owner; // The hold in `slot->lockOwners()`, see `RwMutexLockGuard::releaseTracked()`.
 };
-static_assert(sizeof(C_LockedView) == 4 * 8);
+static_assert(sizeof(C_LockedView) == 5 * 8);
+
+namespace {
+    // The read hold stays registered, so a foreign consumer dying with the view does not wedge the slot.
+    C_LockedView toC(LockedView& lv) {
+        C_LockedView clv;
+        clv.ptr   = lv.span.ptr;
+        clv.len   = lv.span.len;
+        clv.owner = lv.lck.owner();
+        clv.mtx   = lv.lck.releaseTracked();
+        clv.slot  = lv.slot;
+        return clv;
+    }
+}
 
 // -----------------------------------------------------
 // ClientDomain
@@ -42,16 +56,9 @@ void babus_client_slot_write(ClientSlot* cs, void* ptr, size_t len) {
 }
 
 C_LockedView babus_client_slot_read_locked_view(ClientSlot* cs) {
-    C_LockedView clv;
     // SPDLOG_INFO("read ClientSlot @ 0x{:0x}", (size_t)cs);
-    auto lv  = cs->read();
-
-    clv.ptr  = lv.span.ptr;
-    clv.len  = lv.span.len;
-    clv.mtx  = lv.lck.forgetUnsafe();
-    clv.slot = lv.slot;
-
-    return clv;
+    auto lv = cs->read();
+    return toC(lv);
 }
 
 // -----------------------------------------------------
@@ -64,6 +71,7 @@ void babus_unlock_view(C_LockedView* clv) {
 
     assert(clv->mtx != nullptr);
     // if (clv->mtx)
+    clv->slot->lockOwners().removeReader(clv->owner);
     clv->mtx->r_unlock();
 }
 
@@ -73,6 +81,13 @@ void* babus_locked_view_data(C_LockedView* clv) {
 size_t babus_locked_view_length(C_LockedView* clv) {
     return clv->len;
 }
+// `CLOCK_MONOTONIC` nanoseconds at which the viewed data was published.
+int64_t babus_locked_view_publish_nanos(C_LockedView* clv) {
+    return clv->slot->publishNanos;
+}
+int32_t babus_locked_view_publisher_pid(C_LockedView* clv) {
+    return clv->slot->publisherPid;
+}
 
 // -----------------------------------------------------
 // Waiter
@@ -82,7 +97,7 @@ Waiter* babus_waiter_alloc(ClientDomain* cd) {
     return new Waiter(cd->ptr());
 }
 void babus_waiter_free(Waiter* w) {
-    free(w);
+    delete w;
 }
 
 void babus_waiter_subscribe_to(Waiter* waiter, ClientSlot* cs, bool wakeWith) {
@@ -94,18 +109,17 @@ void babus_waiter_unsubscribe_from(Waiter* waiter, ClientSlot* cs) {
 void babus_waiter_wait_exclusive(Waiter* waiter) {
     waiter->waitExclusive();
 }
+int babus_waiter_poll_fd(Waiter* waiter) {
+    return waiter->pollFd();
+}
+void babus_waiter_drain_poll_fd(Waiter* waiter) {
+    waiter->drainPollFd();
+}
 
 // The user must pass a function pointer that takes C_LockedView and an arbirtray pointer that they may or may not make use of.
 using ForEachNewSlotCallback = void (*)(C_LockedView, void*);
 
 uint32_t babus_waiter_for_each_new_slot(Waiter* waiter, void* userData, ForEachNewSlotCallback callback) {
-    return waiter->forEachNewSlot([=](LockedView&& lv) {
-        C_LockedView clv;
-        clv.ptr  = lv.span.ptr;
-        clv.len  = lv.span.len;
-        clv.mtx  = lv.lck.forgetUnsafe();
-        clv.slot = lv.slot;
-        callback(clv, userData);
-    });
+    return waiter->forEachNewSlot([=](LockedView&& lv) { callback(toC(lv), userData); });
 }
 }
@@ -3,6 +3,7 @@
 
 #include <spdlog/spdlog.h>
 
+#include <atomic>
 #include <cerrno>
 #include <fcntl.h>
 #include <sys/mman.h>
@@ -41,6 +42,10 @@ namespace babus {
         truncateOnCreate_ = false;
         return *this;
     }
+    MmapBuilder& MmapBuilder::initializeWith(std::function<void(void*)> init) {
+        init_ = std::move(init);
+        return *this;
+    }
 
     Mmap MmapBuilder::build() {
         if (not(anonymous_ ^ (path_.length() > 0))) {
@@ -52,56 +57,53 @@ namespace babus {
             throw std::runtime_error("must set size");
         }
 
-        int fd         = -1;
         void* mmap_ptr = 0;
 
         if (anonymous_) {
             SPDLOG_DEBUG("anonymous specified.");
-            fd = -1;
+            mmap_ptr = mapFd(-1);
         } else {
             SPDLOG_DEBUG("will open file '{}'", path_);
-            int flags = O_RDWR;
-            // if (allowCreate_) flags |= O_CREAT;
-
-            fd = open(path_.c_str(), flags, 0777);
-
-            if (fd < 0) {
-
-                //
-                // FIXME: This is NOT correct. We must use a file lock to make sure nobody creates the file before
-                // we get in and do it.
-                //
-
-                if (allowCreate_) {
-                    SPDLOG_DEBUG("first open('{}') failed with errno {} ('{}') but `allowCreate_` is true. Trying to create it.", path_,
-                                 errno, strerror(errno));
-                    flags |= O_CREAT;
-                    flags |= O_EXCL;
-                    fd = open(path_.c_str(), flags, 0777);
-
-                    if (fd < 0) {
-                        SPDLOG_ERROR("second open('{}') failed with errno {} ('{}')", path_, errno, strerror(errno));
-                        throw std::runtime_error("open failed");
-                    } else {
-                        SPDLOG_DEBUG("Created file '{}'.", path_);
-                        didCreateFile_ = true;
-                    }
-
+            int fd = open(path_.c_str(), O_RDWR, 0777);
+
+            if (fd < 0 and errno == ENOENT and allowCreate_) {
+                SPDLOG_DEBUG("first open('{}') failed with errno {} ('{}') but `allowCreate_` is true. Trying to create it.", path_,
+                             errno, strerror(errno));
+                mmap_ptr = createAndPublish();
+                if (mmap_ptr != nullptr) {
+                    didCreateFile_ = true;
                 } else {
-                    SPDLOG_ERROR("first open('{}') failed with errno {} ('{}') and `allowCreate_` is false", path_, errno,
-                                 strerror(errno));
+                    // Someone else created it first. Their file is complete, or they would not have published it.
+                    fd = open(path_.c_str(), O_RDWR, 0777);
+                }
+            }
+
+            if (mmap_ptr == nullptr) {
+                if (fd < 0) {
+                    SPDLOG_ERROR("open('{}') failed with errno {} ('{}') (`allowCreate_` {})", path_, errno, strerror(errno),
+                                 allowCreate_);
                     throw std::runtime_error("open failed");
                 }
-            } else {
                 SPDLOG_TRACE("opened existing file '{}'.", path_);
+                try {
+                    mmap_ptr = mapFd(fd);
+                } catch (...) {
+                    close(fd);
+                    throw;
+                }
+                if (close(fd) != 0) {
+                    SPDLOG_ERROR("after mmap(), close('{}') failed with errno {} ('{}')", path_, errno, strerror(errno));
+                    throw std::runtime_error("close failed");
+                }
             }
         }
 
-        if (didCreateFile_ and truncateOnCreate_) {
-            SPDLOG_DEBUG("Since created file, truncating len={}.", size_);
-            ftruncate(fd, size_);
-        }
+        didBuild_ = true;
+        Mmap map(mmap_ptr, size_);
+        return map;
+    }
 
+    void* MmapBuilder::mapFd(int fd) {
         int flags = 0;
         if (targetAddr_) flags |= MAP_FIXED;
         if (anonymous_)
@@ -114,25 +116,83 @@ namespace babus {
         if (useTwoMegabytePages_) flags |= MAP_HUGETLB;
 #endif
 
-        mmap_ptr = mmap(targetAddr_, size_, PROT_READ | PROT_WRITE, flags, fd, 0);
+        void* mmap_ptr = mmap(targetAddr_, size_, PROT_READ | PROT_WRITE, flags, fd, 0);
         SPDLOG_TRACE("mmap @ 0x{:0x}", (std::size_t)mmap_ptr);
 
-        if (mmap_ptr == 0) {
-            SPDLOG_CRITICAL("mmap failed with errno {} ('{}')", path_, errno, strerror(errno));
+        if (mmap_ptr == MAP_FAILED) {
+            SPDLOG_CRITICAL("mmap('{}') failed with errno {} ('{}')", path_, errno, strerror(errno));
             throw std::runtime_error("mmap failed");
         }
+        return mmap_ptr;
+    }
+
+    //
+    // Creating in place is racy: another process could open and map the file between our `open(O_CREAT)` and
+    // `init_`, then see garbage (and fail its magic check). Instead, build the file without a name (`O_TMPFILE`) and
+    // `linkat()` it into place once initialized, so a crash on the way leaves nothing behind. File systems without
+    // `O_TMPFILE` get a hidden temporary name instead (`.<name>.<pid>.<n>`, see `babusctl rm --temp`). Linking never
+    // replaces an existing file, so when several processes create at once, exactly one wins and the others open the
+    // winner's file. Nobody waits or retries.
+    //
+    // Returns null if another process won.
+    //
+    void* MmapBuilder::createAndPublish() {
+        static std::atomic<uint32_t> counter { 0 };
+        auto slash      = path_.rfind('/');
+        std::string dir = slash == std::string::npos ? "" : path_.substr(0, slash + 1);
+        std::string tmp;
+
+        // EISDIR: the kernel predates `O_TMPFILE`.
+        bool named = false;
+        int fd     = open(dir.empty() ? "." : dir.c_str(), O_RDWR | O_TMPFILE, 0777);
+        if (fd >= 0) {
+            // `linkat(fd, "", ..., AT_EMPTY_PATH)` would need CAP_DAC_READ_SEARCH.
+            tmp = fmt::format("/proc/self/fd/{}", fd);
+        } else if (errno == EOPNOTSUPP or errno == EISDIR) {
+            named = true;
+            tmp   = fmt::format("{}.{}.{}.{}", dir, path_.substr(dir.length()), getpid(), counter++);
+            fd    = open(tmp.c_str(), O_RDWR | O_CREAT | O_EXCL, 0777);
+        }
+        if (fd < 0) {
+            SPDLOG_ERROR("open('{}') failed with errno {} ('{}')", named ? tmp : dir, errno, strerror(errno));
+            throw std::runtime_error("open failed");
+        }
 
-        if (fd > 0) {
-            int closeStat = close(fd);
-            if (closeStat != 0) {
-                SPDLOG_ERROR("after mmap(), close('{}') failed with errno {} ('{}')", path_, errno, strerror(errno));
-                throw std::runtime_error("close failed");
+        void* mmap_ptr = nullptr;
+        int linkStat   = -1;
+        int linkErrno  = 0;
+        try {
+            if (truncateOnCreate_) {
+                SPDLOG_DEBUG("Since created file, truncating len={}.", size_);
+                if (ftruncate(fd, size_) != 0) {
+                    SPDLOG_ERROR("ftruncate('{}') failed with errno {} ('{}')", tmp, errno, strerror(errno));
+                    throw std::runtime_error("ftruncate failed");
+                }
             }
+            mmap_ptr = mapFd(fd);
+            if (init_) init_(mmap_ptr);
+            linkStat  = linkat(AT_FDCWD, tmp.c_str(), AT_FDCWD, path_.c_str(), named ? 0 : AT_SYMLINK_FOLLOW);
+            linkErrno = errno;
+        } catch (...) {
+            if (mmap_ptr) munmap(mmap_ptr, size_);
+            if (named) unlink(tmp.c_str());
+            close(fd);
+            throw;
         }
+        if (named) unlink(tmp.c_str());
+        close(fd);
 
-        didBuild_ = true;
-        Mmap map(mmap_ptr, size_);
-        return map;
+        if (linkStat == 0) {
+            SPDLOG_DEBUG("Created file '{}'.", path_);
+            return mmap_ptr;
+        }
+        munmap(mmap_ptr, size_);
+        if (linkErrno == EEXIST) {
+            SPDLOG_DEBUG("'{}' was created concurrently by someone else, using theirs.", path_);
+            return nullptr;
+        }
+        SPDLOG_ERROR("link('{}', '{}') failed with errno {} ('{}')", tmp, path_, linkErrno, strerror(linkErrno));
+        throw std::runtime_error("link failed");
     }
 
     Mmap::Mmap(void* addr, std::size_t len)
@@ -2,6 +2,7 @@
 
 #include <cassert>
 #include <cstdint>
+#include <functional>
 #include <string>
 
 namespace babus {
@@ -22,6 +23,8 @@ namespace babus {
         MmapBuilder& useTwoMegabytePages();
         MmapBuilder& targetAddr(void* addr);
         MmapBuilder& doNotTruncateOnCreate(); // This is by default on.
+        // Runs on the mapping of a file this build creates, before any other process can open the file.
+        MmapBuilder& initializeWith(std::function<void(void*)> init);
 
         Mmap build();
 
@@ -34,6 +37,9 @@ namespace babus {
         }
 
     private:
+        void* mapFd(int fd);
+        void* createAndPublish();
+
         bool allowCreate_         = false;
         bool anonymous_           = false;
         bool useTwoMegabytePages_ = false;
@@ -41,6 +47,7 @@ namespace babus {
         void* targetAddr_         = nullptr;
         std::string path_;
         std::size_t size_;
+        std::function<void(void*)> init_;
 
         bool didCreateFile_ = false;
         bool didBuild_      = false;
@@ -61,6 +68,9 @@ namespace babus {
         inline void* ptr() const {
             return addr_;
         }
+        inline std::size_t size() const {
+            return len_;
+        }
 
     private:
         friend struct MmapBuilder;
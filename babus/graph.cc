@@ -0,0 +1,266 @@
+#include "graph.h"
+
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <pthread.h>
+#include <sched.h>
+
+namespace babus {
+
+    struct LocalEdge {
+        std::string name;
+        uint32_t mask = 0; // Bit on `Graph::localSeq_`.
+        std::atomic<uint32_t> seq { 0 };
+
+        std::mutex mtx;
+        std::shared_ptr<const std::vector<uint8_t>> message;
+    };
+
+    struct Graph::Node {
+        NodeSpec spec;
+        NodeIo io;
+        uint32_t sharedMask = 0; // Bits of the shared inputs on the domain counter.
+        uint32_t localMask  = 0; // Bits of the local inputs on `Graph::localSeq_`.
+        std::thread thread;
+
+        std::atomic<uint64_t> runs { 0 };
+        std::atomic<int64_t> totalNanos { 0 };
+        std::atomic<int64_t> maxNanos { 0 };
+    };
+
+    namespace {
+        // Local edges use the other 31 bits of `Graph::localSeq_`.
+        constexpr uint32_t SharedInputsBit = 1u << 31;
+
+        int64_t getNanos() {
+            using namespace std::chrono;
+            return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+        }
+
+        void pinToCpu(const std::string& name, int cpu) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            if (int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set); err != 0)
+                SPDLOG_WARN("could not pin node '{}' to cpu {} (err {} '{}')", name, cpu, err, strerror(err));
+        }
+    }
+
+    ByteSpan NodeIo::output(std::size_t i, std::size_t len) {
+        Output& o = outputs_[i];
+        if (o.slot) {
+            if (len > SlotDataCapacity) throw std::runtime_error("output larger than slot capacity");
+            if (!o.view) o.view.emplace(o.slot->beginWrite());
+            return ByteSpan { o.view->span.ptr, len };
+        }
+
+        o.message = std::make_shared<std::vector<uint8_t>>(len);
+        return ByteSpan { o.message->data(), len };
+    }
+
+    void NodeIo::publish(std::size_t i, std::size_t len) {
+        Output& o = outputs_[i];
+        if (o.slot) {
+            assert(o.view.has_value() && "publish() without output()");
+            o.view->commit(len);
+            o.view.reset();
+            return;
+        }
+
+        assert(o.message != nullptr && "publish() without output()");
+        o.message->resize(len);
+        {
+            std::lock_guard<std::mutex> lck(o.edge->mtx);
+            o.edge->message = std::move(o.message);
+        }
+        o.edge->seq++;
+        localSeq_->increment(o.edge->mask);
+    }
+
+    void NodeIo::write(std::size_t i, ByteSpan span) {
+        ByteSpan out = output(i, span.len);
+        copyBytes(out.ptr, span.ptr, span.len);
+        publish(i, span.len);
+    }
+
+    Graph::Graph(ClientDomain& domain)
+        : domain_(domain) {
+    }
+
+    Graph::~Graph() {
+        stop();
+    }
+
+    LocalEdge* Graph::findLocalEdge(const std::string& name) {
+        for (auto& e : localEdges_)
+            if (e->name == name) return e.get();
+        return nullptr;
+    }
+
+    void Graph::addLocalEdge(const std::string& name) {
+        if (findLocalEdge(name)) return;
+        auto edge  = std::make_unique<LocalEdge>();
+        edge->name = name;
+        // Sharing a bit with another local edge only costs a spurious wakeup.
+        edge->mask = 1u << (localEdges_.size() % 31);
+        localEdges_.push_back(std::move(edge));
+    }
+
+    void Graph::addNode(NodeSpec spec) {
+        if (spec.inputs.empty()) throw std::runtime_error("graph nodes need at least one input");
+
+        auto node         = std::make_unique<Node>();
+        node->io.localSeq_ = &localSeq_;
+
+        for (const auto& name : spec.inputs) {
+            NodeIo::Input in;
+            if ((in.edge = findLocalEdge(name))) {
+                node->localMask |= in.edge->mask;
+            } else {
+                in.slot = domain_.getSlot(name.c_str()).ptr();
+                node->sharedMask |= in.slot->eventMask();
+            }
+            node->io.inputs_.push_back(std::move(in));
+        }
+
+        for (const auto& name : spec.outputs) {
+            NodeIo::Output out;
+            if (!(out.edge = findLocalEdge(name))) out.slot = &domain_.getSlot(name.c_str());
+            node->io.outputs_.push_back(std::move(out));
+        }
+
+        node->spec = std::move(spec);
+        nodes_.push_back(std::move(node));
+    }
+
+    void Graph::start() {
+        stop_ = false;
+
+        // Shared inputs of nodes that sleep on `localSeq_`.
+        std::vector<Slot*> forwarded;
+        uint32_t forwardedMask = 0;
+        for (auto& node : nodes_) {
+            if (node->localMask == 0) continue;
+            for (auto& in : node->io.inputs_)
+                if (in.slot) forwarded.push_back(in.slot);
+            forwardedMask |= node->sharedMask;
+        }
+        if (!forwarded.empty()) forwardThread_ = std::thread(&Graph::forwardSharedInputs, this, std::move(forwarded), forwardedMask);
+
+        for (auto& node : nodes_) {
+            // Like `WaitTarget`, only react to data published after we started.
+            for (auto& in : node->io.inputs_) in.lastSeq = in.slot ? in.slot->seq.load() : in.edge->seq.load();
+            node->thread = std::thread(&Graph::runNode, this, std::ref(*node));
+        }
+    }
+
+    void Graph::stop() {
+        if (stop_.exchange(true)) return;
+
+        // Only wakes nodes sleeping on local edges. The others sleep on the shared domain counter, where a wake would
+        // reach other processes' waiters too, so they notice within `StopCheckNanos`.
+        localSeq_.increment(~0u);
+
+        for (auto& node : nodes_)
+            if (node->thread.joinable()) node->thread.join();
+        if (forwardThread_.joinable()) forwardThread_.join();
+    }
+
+    std::vector<NodeStats> Graph::stats() const {
+        std::vector<NodeStats> out;
+        for (const auto& node : nodes_) {
+            NodeStats s;
+            s.name       = node->spec.name;
+            s.runs       = node->runs.load();
+            s.totalNanos = node->totalNanos.load();
+            s.maxNanos   = node->maxNanos.load();
+            out.push_back(s);
+        }
+        return out;
+    }
+
+    void Graph::runNode(Node& node) {
+        if (node.spec.cpu >= 0) pinToCpu(node.spec.name, node.spec.cpu);
+
+        Domain* dom = domain_.ptr();
+        NodeIo& io  = node.io;
+
+        while (true) {
+            // Sample before checking inputs, so that a publish in between makes the wait return.
+            uint32_t prv = node.localMask ? localSeq_.load() : dom->seq.load();
+            if (stop_) break;
+
+            bool anyNew = false;
+            for (auto& in : io.inputs_) {
+                uint32_t cur = in.slot ? in.slot->seq.load() : in.edge->seq.load();
+                in.isNew     = cur > in.lastSeq;
+                anyNew |= in.isNew;
+            }
+            if (!anyNew) {
+                if (node.localMask)
+                    localSeq_.waitForChange(prv, node.localMask | (node.sharedMask ? SharedInputsBit : 0));
+                else
+                    dom->seq.waitForChangeFor(prv, node.sharedMask, StopCheckNanos);
+                continue;
+            }
+
+            // Every input is visible to the compute function, not only the new ones.
+            for (auto& in : io.inputs_) {
+                if (in.slot) {
+                    in.view.emplace(in.slot->read());
+                    in.lastSeq = in.slot->seq.load(); // Stable while we hold the read lock.
+                    in.span    = in.view->span;
+                } else {
+                    std::lock_guard<std::mutex> lck(in.edge->mtx);
+                    in.lastSeq = in.edge->seq.load();
+                    in.message = in.edge->message;
+                    in.span    = in.message ? ByteSpan { (void*)in.message->data(), in.message->size() } : ByteSpan {};
+                }
+            }
+
+            int64_t start = getNanos();
+            node.spec.compute(io);
+            int64_t elapsed = getNanos() - start;
+
+            node.runs++;
+            node.totalNanos += elapsed;
+            if (elapsed > node.maxNanos.load()) node.maxNanos = elapsed;
+
+            for (auto& in : io.inputs_) {
+                in.view.reset();
+                in.message.reset();
+                in.span = {};
+            }
+            // Outputs that were requested but not published are released without publishing.
+            for (auto& out : io.outputs_) {
+                out.view.reset();
+                out.message.reset();
+            }
+        }
+    }
+
+    // Wakes the nodes with local inputs, which sleep on `localSeq_`, when one of their shared inputs is written.
+    void Graph::forwardSharedInputs(std::vector<Slot*> slots, uint32_t mask) {
+        Domain* dom = domain_.ptr();
+        std::vector<uint32_t> lastSeqs;
+        for (Slot* slot : slots) lastSeqs.push_back(slot->seq.load());
+
+        while (true) {
+            // Sample before checking the slots, so that a publish in between makes the wait return.
+            uint32_t prv = dom->seq.load();
+            if (stop_) break;
+
+            bool anyNew = false;
+            for (std::size_t i = 0; i < slots.size(); i++) {
+                uint32_t cur = slots[i]->seq.load();
+                anyNew |= cur != lastSeqs[i];
+                lastSeqs[i] = cur;
+            }
+            if (anyNew) localSeq_.increment(SharedInputsBit);
+
+            dom->seq.waitForChangeFor(prv, mask, StopCheckNanos);
+        }
+    }
+
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "client.h"
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace babus {
+
+    //
+    // `Graph` runs "read slot A, compute, write slot B" pipelines, so processes don't each re-implement the
+    // `Waiter` loop, threading and stop handling.
+    //
+    // Every node declares named inputs and outputs and a compute function. Each node runs on its own worker
+    // thread (optionally pinned to a cpu). The runtime wakes a node when any of its inputs changes, hands it
+    // the new inputs, and records how long each compute call took.
+    //
+    // Edges are shared-memory slots by default. Edges named with `addLocalEdge()` never touch shared memory:
+    // the producing node publishes a buffer and consuming nodes in this process receive it by pointer. They are
+    // woken through a process-local futex, so local traffic never wakes other processes. A node with both local
+    // and shared inputs sleeps on that local futex too; a helper thread watches its shared inputs and forwards
+    // their writes.
+    //
+    // Outputs are written in place: `NodeIo::output()` returns the output slot's own memory (holding its write
+    // lock), and `NodeIo::publish()` commits it, so there's no intermediate buffer or copy.
+    //
+    // NOTE: Inputs hold their slot's read lock while the node computes. A cycle through shared-memory edges can
+    //       therefore deadlock (each node holds its input while waiting to write the other's), so keep those acyclic.
+    //
+
+    struct LocalEdge;
+
+    class NodeIo {
+    public:
+        // Number of inputs/outputs, in the order they were declared in the `NodeSpec`.
+        inline std::size_t numInputs() const {
+            return inputs_.size();
+        }
+        inline std::size_t numOutputs() const {
+            return outputs_.size();
+        }
+
+        // True if input `i` changed since the node last ran.
+        inline bool isNew(std::size_t i) const {
+            return inputs_[i].isNew;
+        }
+
+        // The latest data of input `i`. Empty if that input was never published.
+        inline ByteSpan input(std::size_t i) const {
+            return inputs_[i].span;
+        }
+
+        // Memory of at least `len` bytes to write output `i` into. Call `publish(i, len)` when done.
+        ByteSpan output(std::size_t i, std::size_t len);
+
+        // Publish the first `len` bytes of the buffer returned by `output(i, ...)`.
+        void publish(std::size_t i, std::size_t len);
+
+        // Convenience: copy `span` to output `i` and publish it.
+        void write(std::size_t i, ByteSpan span);
+
+    private:
+        friend class Graph;
+
+        struct Input {
+            Slot* slot       = nullptr;
+            LocalEdge* edge  = nullptr;
+            uint32_t lastSeq = 0;
+
+            bool isNew = false;
+            ByteSpan span;
+            std::optional<LockedView> view;
+            std::shared_ptr<const std::vector<uint8_t>> message;
+        };
+
+        struct Output {
+            ClientSlot* slot = nullptr;
+            LocalEdge* edge  = nullptr;
+
+            std::optional<WriteView> view;
+            std::shared_ptr<std::vector<uint8_t>> message;
+        };
+
+        SequenceCounter* localSeq_ = nullptr; // `Graph::localSeq_`, which local edges signal.
+        std::vector<Input> inputs_;
+        std::vector<Output> outputs_;
+    };
+
+    struct NodeSpec {
+        std::string name;
+        std::vector<std::string> inputs;
+        std::vector<std::string> outputs;
+        std::function<void(NodeIo&)> compute;
+        int cpu = -1; // Pin the node's thread to this cpu, if non-negative.
+    };
+
+    struct NodeStats {
+        std::string name;
+        uint64_t runs      = 0;
+        int64_t totalNanos = 0;
+        int64_t maxNanos   = 0;
+    };
+
+    class Graph {
+    public:
+        Graph(ClientDomain& domain);
+        ~Graph();
+        Graph(const Graph&)            = delete;
+        Graph& operator=(const Graph&) = delete;
+
+        // Must be called before any node using `name` is added.
+        void addLocalEdge(const std::string& name);
+
+        // Must be called before `start()`.
+        void addNode(NodeSpec spec);
+
+        void start();
+        // Nodes that only have shared inputs, and the helper thread, notice within `StopCheckNanos`.
+        void stop();
+
+        std::vector<NodeStats> stats() const;
+
+    private:
+        struct Node;
+
+        ClientDomain& domain_;
+        std::vector<std::unique_ptr<LocalEdge>> localEdges_;
+        std::vector<std::unique_ptr<Node>> nodes_;
+        std::atomic<bool> stop_ { false };
+
+        // Process-private counter that local edges increment with their bit, and `SharedInputsBit` on behalf of the
+        // shared inputs of nodes that also have local ones.
+        SequenceCounter localSeq_;
+        std::thread forwardThread_;
+
+        LocalEdge* findLocalEdge(const std::string& name);
+        void runNode(Node& node);
+        void forwardSharedInputs(std::vector<Slot*> slots, uint32_t mask);
+    };
+
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "copy.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace babus {
+
+    //
+    // Images in slots. A writer publishes pixels with `Slot::writeImage()` (or sets `WriteView::image`), which records
+    // an `ImageLayout` in the slot header next to the data. Readers get it back as `LockedView::image` and copy just the
+    // part they need through `LockedView::imageView()`, instead of cloning the whole frame under the read lock:
+    //
+    //      auto view = slot->read();
+    //      if (ImageView img = view.imageView(); img.valid()) img.copyRegion({ 640, 360, 640, 360 }, { crop.data(), crop.size() });
+    //
+    // Only packed single-plane formats, where every pixel is a whole number of bytes.
+    //
+
+    enum class PixelFormat : uint32_t {
+        Unknown = 0, // Not an image (the layout of plain byte writes).
+        Gray8,
+        Gray16,
+        Rgb8,
+        Bgr8,
+        Rgba8,
+        Bgra8,
+        GrayF32,
+    };
+
+    inline constexpr uint32_t bytesPerPixel(PixelFormat f) {
+        switch (f) {
+            case PixelFormat::Gray8: return 1;
+            case PixelFormat::Gray16: return 2;
+            case PixelFormat::Rgb8:
+            case PixelFormat::Bgr8: return 3;
+            case PixelFormat::Rgba8:
+            case PixelFormat::Bgra8:
+            case PixelFormat::GrayF32: return 4;
+            default: return 0;
+        }
+    }
+
+    struct ImageLayout {
+        uint32_t width      = 0;
+        uint32_t height     = 0;
+        uint32_t stride     = 0; // Bytes from one row to the next, at least `width * bytesPerPixel(format)`.
+        PixelFormat format  = PixelFormat::Unknown;
+
+        inline std::size_t rowBytes() const {
+            return std::size_t(width) * bytesPerPixel(format);
+        }
+        inline std::size_t byteSize() const {
+            return height == 0 ? 0 : std::size_t(stride) * (height - 1) + rowBytes();
+        }
+    };
+
+    static_assert(sizeof(ImageLayout) == 16, "ImageLayout is part of the slot header");
+
+    struct ImageRoi {
+        uint32_t x = 0, y = 0, width = 0, height = 0;
+    };
+
+    // Read-only access to an image in a `LockedView`. Only valid while the view (and its read lock) is.
+    struct ImageView {
+        const uint8_t* data = nullptr;
+        std::size_t len     = 0;
+        ImageLayout layout;
+
+        // False for slots not written as images, and for layouts that do not fit the data.
+        inline bool valid() const {
+            return data != nullptr and bytesPerPixel(layout.format) != 0 and layout.stride >= layout.rowBytes()
+                   and layout.byteSize() <= len;
+        }
+
+        inline const uint8_t* row(uint32_t y) const {
+            return data + std::size_t(y) * layout.stride;
+        }
+
+        // Copy `roi` (clipped to the image) into `dst` as packed rows, or rows `dstStride` bytes apart. Stops at the
+        // last row that fits in `dst`. Returns the bytes copied.
+        inline std::size_t copyRegion(ImageRoi roi, void* dst, std::size_t dstLen, std::size_t dstStride = 0) const {
+            if (!valid() or roi.x >= layout.width or roi.y >= layout.height) return 0;
+            uint32_t w        = std::min(roi.width, layout.width - roi.x);
+            uint32_t h        = std::min(roi.height, layout.height - roi.y);
+            std::size_t bpp   = bytesPerPixel(layout.format);
+            std::size_t bytes = w * bpp;
+            if (dstStride == 0) dstStride = bytes;
+
+            std::size_t copied = 0;
+            uint8_t* out       = static_cast<uint8_t*>(dst);
+            for (uint32_t r = 0; r < h and r * dstStride + bytes <= dstLen; r++) {
+                copyBytes(out + r * dstStride, row(roi.y + r) + roi.x * bpp, bytes);
+                copied += bytes;
+            }
+            return copied;
+        }
+
+        // Layout of `copyDownsampled(factor, ...)`'s output: packed, every `factor`th pixel of every `factor`th row.
+        inline ImageLayout downsampledLayout(uint32_t factor) const {
+            ImageLayout out = layout;
+            out.width       = (layout.width + factor - 1) / factor;
+            out.height      = (layout.height + factor - 1) / factor;
+            out.stride      = out.width * bytesPerPixel(layout.format);
+            return out;
+        }
+
+        // Nearest-neighbour downsample into `dst` (see `downsampledLayout`). Returns the bytes copied.
+        inline std::size_t copyDownsampled(uint32_t factor, void* dst, std::size_t dstLen) const {
+            if (!valid() or factor == 0) return 0;
+            if (factor == 1) return copyRegion({ 0, 0, layout.width, layout.height }, dst, dstLen);
+            switch (bytesPerPixel(layout.format)) {
+                case 1: return downsample<1>(factor, dst, dstLen);
+                case 2: return downsample<2>(factor, dst, dstLen);
+                case 3: return downsample<3>(factor, dst, dstLen);
+                case 4: return downsample<4>(factor, dst, dstLen);
+                default: return 0;
+            }
+        }
+
+    private:
+        // The pixel size as a constant, so the per-pixel copy is a plain load and store.
+        template <std::size_t Bpp> inline std::size_t downsample(uint32_t factor, void* dst, std::size_t dstLen) const {
+            ImageLayout out = downsampledLayout(factor);
+            uint8_t* o      = static_cast<uint8_t*>(dst);
+            std::size_t n   = 0;
+            for (uint32_t r = 0; r < out.height and n + out.stride <= dstLen; r++) {
+                const uint8_t* in = row(r * factor);
+                uint8_t* outRow   = o + n;
+                uint32_t c        = 0;
+                if constexpr (Bpp == 3) {
+                    // Move 3 byte pixels as 4 bytes, the extra one is overwritten by the next pixel.
+                    for (; c + 1 < out.width; c++) memcpy(outRow + c * 3, in + std::size_t(c) * factor * 3, 4);
+                }
+                for (; c < out.width; c++) memcpy(outRow + c * Bpp, in + std::size_t(c) * factor * Bpp, Bpp);
+                n += out.stride;
+            }
+            return n;
+        }
+    };
+
+}
@@ -0,0 +1,106 @@
+#include "pollfd.h"
+#include "detail/claim_entry.hpp"
+#include "domain.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace babus {
+
+    namespace {
+
+        socklen_t makeAbstractAddr(sockaddr_un& sa, const char* name) {
+            memset(&sa, 0, sizeof(sa));
+            sa.sun_family = AF_UNIX;
+            auto len      = strnlen(name, sizeof(PollerEntry::addr));
+            memcpy(sa.sun_path + 1, name, len);
+            return offsetof(sockaddr_un, sun_path) + 1 + len;
+        }
+
+        // One unbound socket per process is enough to send to every poller.
+        int publisherSocket() {
+            static int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            return fd;
+        }
+
+    }
+
+    void PollerTable::notify(uint32_t mask) {
+        for (auto& e : entries) {
+            if (e.state.load() != PollerEntry::Active) continue;
+            if ((e.mask.load() & mask) == 0) continue;
+            if (e.pending.exchange(1) != 0) continue;
+
+            sockaddr_un sa;
+            socklen_t len = makeAbstractAddr(sa, e.addr);
+            char c        = 0;
+            if (sendto(publisherSocket(), &c, 1, MSG_DONTWAIT | MSG_NOSIGNAL, (const sockaddr*)&sa, len) < 0) {
+                // ECONNREFUSED: the poller is gone. EAGAIN: its queue is full, so it will wake anyway.
+                SPDLOG_TRACE("poller '{}' sendto errno {} ('{}')", e.addr, errno, strerror(errno));
+            }
+        }
+    }
+
+    PollRegistration::PollRegistration(Domain* domain, uint32_t mask)
+        : domain_(domain) {
+        static std::atomic<uint32_t> counter { 0 };
+
+        fd_ = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd_ < 0) {
+            SPDLOG_ERROR("socket() failed with errno {} ('{}')", errno, strerror(errno));
+            throw std::runtime_error("socket failed");
+        }
+
+        entry_ = claimEntry(domain_->pollers.entries, [this](PollerEntry& e) {
+            SPDLOG_WARN("reclaiming poller entry of dead pid {}", e.pid);
+            domain_->pollers.numActive--;
+        });
+        if (entry_ == nullptr) {
+            close(fd_);
+            SPDLOG_ERROR("all {} poller entries of the domain are in use", MaxPollers);
+            throw std::runtime_error("no free poller entries");
+        }
+
+        entry_->pid = getpid();
+        snprintf(entry_->addr, sizeof(entry_->addr), "babus.%d.%u.%lx", getpid(), counter++, (unsigned long)(std::size_t)this);
+
+        sockaddr_un sa;
+        socklen_t len = makeAbstractAddr(sa, entry_->addr);
+        if (bind(fd_, (const sockaddr*)&sa, len) != 0) {
+            SPDLOG_ERROR("bind('{}') failed with errno {} ('{}')", entry_->addr, errno, strerror(errno));
+            close(fd_);
+            entry_->state.store(PollerEntry::Free);
+            throw std::runtime_error("bind failed");
+        }
+
+        entry_->mask.store(mask);
+        entry_->pending.store(0);
+        entry_->state.store(PollerEntry::Active);
+        domain_->pollers.numActive++;
+        SPDLOG_DEBUG("registered poller '{}' with mask {:#x}", entry_->addr, mask);
+    }
+
+    PollRegistration::~PollRegistration() {
+        if (entry_) {
+            entry_->state.store(PollerEntry::Busy);
+            domain_->pollers.numActive--;
+            entry_->mask.store(0);
+            entry_->state.store(PollerEntry::Free);
+        }
+        if (fd_ >= 0) close(fd_);
+    }
+
+    void PollRegistration::setMask(uint32_t mask) {
+        entry_->mask.store(mask);
+    }
+
+    void PollRegistration::drain() {
+        char buf[16];
+        while (recv(fd_, buf, sizeof(buf), MSG_DONTWAIT) > 0) { }
+        entry_->pending.store(0);
+    }
+
+}
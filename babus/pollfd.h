@@ -0,0 +1,71 @@
+#pragma once
+
+#include "babus/common.h"
+
+#include <atomic>
+#include <cstdint>
+
+namespace babus {
+
+    //
+    // Futex words cannot be polled, so a thread blocked in `Waiter::waitExclusive` can't also serve sockets and
+    // timers. A `PollRegistration` is the event-loop alternative: a process-private fd that becomes readable
+    // (POLLIN) when a slot in its mask is written. Add it to epoll/poll, or submit it to io_uring with
+    // IORING_OP_POLL_ADD.
+    //
+    // Each registration owns one entry of the domain's `PollerTable`. The fd is an AF_UNIX datagram socket bound in
+    // the abstract namespace (so there is no file to clean up), and publishers `sendto` it without blocking.
+    // At most one datagram is outstanding per registration: the `pending` flag coalesces wakeups, so a fast
+    // publisher costs one atomic exchange per write, not one syscall.
+    //
+    // Publishers only look at the table when `numActive` is non-zero, so domains without pollers pay nothing.
+    //
+    // NOTE: Abstract sockets are scoped to a network namespace, so publishers and pollers must share one.
+    //
+
+    struct PollerEntry {
+        static constexpr uint32_t Free   = 0;
+        static constexpr uint32_t Busy   = 1; // Claimed, being (de)initialized.
+        static constexpr uint32_t Active = 2;
+
+        std::atomic<uint32_t> state;
+        std::atomic<uint32_t> mask;
+        std::atomic<uint32_t> pending;
+        int32_t pid;
+        char addr[48]; // Abstract socket name, without the leading NUL.
+    };
+
+    struct PollerTable {
+        std::atomic<uint32_t> numActive;
+        PollerEntry entries[MaxPollers];
+
+        // Called by publishers after they increment the domain sequence counter.
+        void notify(uint32_t mask);
+    };
+
+    struct Domain;
+
+    class PollRegistration {
+    public:
+        PollRegistration(Domain* domain, uint32_t mask);
+        ~PollRegistration();
+        PollRegistration(const PollRegistration&)            = delete;
+        PollRegistration& operator=(const PollRegistration&) = delete;
+
+        inline int fd() const {
+            return fd_;
+        }
+
+        void setMask(uint32_t mask);
+
+        // Consume pending datagrams and re-arm the registration.
+        // Call this *before* checking sequence counters, otherwise a wakeup may be lost.
+        void drain();
+
+    private:
+        Domain* domain_;
+        PollerEntry* entry_ = nullptr;
+        int fd_             = -1;
+    };
+
+}
@@ -0,0 +1,101 @@
+#include "publisher.h"
+
+namespace babus {
+
+    AsyncPublisher::AsyncPublisher(Slot* slot, Domain* domain, uint32_t maxQueued)
+        : slot_(slot)
+        , domain_(domain)
+        , maxQueued_(maxQueued) {
+        assert(maxQueued > 0);
+        thread_ = std::thread(&AsyncPublisher::loop, this);
+    }
+
+    AsyncPublisher::~AsyncPublisher() {
+        {
+            std::lock_guard<std::mutex> lck(mtx_);
+            stop_ = true;
+        }
+        workCv_.notify_one();
+        thread_.join();
+    }
+
+    void AsyncPublisher::write(std::vector<uint8_t>&& buffer, Done done) {
+        Pending oldest;
+        bool drop = false;
+        {
+            std::lock_guard<std::mutex> lck(mtx_);
+            if (queue_.size() >= maxQueued_) {
+                oldest = std::move(queue_.front());
+                queue_.pop_front();
+                drop = true;
+            }
+            queue_.push_back(Pending { std::move(buffer), std::move(done) });
+        }
+        workCv_.notify_one();
+
+        if (drop) {
+            dropped_.fetch_add(1);
+            SPDLOG_TRACE("slot '{}': async write queue full, dropped the oldest message", slot_->name);
+            finish(false, std::move(oldest));
+        }
+    }
+
+    std::future<bool> AsyncPublisher::write(std::vector<uint8_t>&& buffer) {
+        auto promise = std::make_shared<std::promise<bool>>();
+        auto future  = promise->get_future();
+        write(std::move(buffer), [this, promise](bool published, std::vector<uint8_t>&& done) {
+            finish(published, Pending { std::move(done), nullptr });
+            promise->set_value(published);
+        });
+        return future;
+    }
+
+    std::vector<uint8_t> AsyncPublisher::takeBuffer() {
+        std::lock_guard<std::mutex> lck(mtx_);
+        if (freeBuffers_.empty()) return {};
+        std::vector<uint8_t> out = std::move(freeBuffers_.back());
+        freeBuffers_.pop_back();
+        return out;
+    }
+
+    void AsyncPublisher::finish(bool published, Pending&& pending) {
+        if (pending.done) {
+            pending.done(published, std::move(pending.buffer));
+            return;
+        }
+        std::lock_guard<std::mutex> lck(mtx_);
+        if (freeBuffers_.size() <= maxQueued_) freeBuffers_.push_back(std::move(pending.buffer));
+    }
+
+    void AsyncPublisher::flush() {
+        std::unique_lock<std::mutex> lck(mtx_);
+        idleCv_.wait(lck, [&] { return queue_.empty() and !writing_; });
+    }
+
+    uint32_t AsyncPublisher::queued() {
+        std::lock_guard<std::mutex> lck(mtx_);
+        return queue_.size();
+    }
+
+    void AsyncPublisher::loop() {
+        for (;;) {
+            Pending next;
+            {
+                std::unique_lock<std::mutex> lck(mtx_);
+                writing_ = false;
+                if (queue_.empty()) idleCv_.notify_all();
+                workCv_.wait(lck, [&] { return stop_ or !queue_.empty(); });
+                // Stop only once drained, so nothing written before destruction is lost.
+                if (queue_.empty()) return;
+                next = std::move(queue_.front());
+                queue_.pop_front();
+                writing_ = true;
+            }
+
+            slot_->write(domain_, { next.buffer.data(), next.buffer.size() });
+            published_.fetch_add(1);
+            finish(true, std::move(next));
+        }
+    }
+
+}
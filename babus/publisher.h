@@ -0,0 +1,92 @@
+#pragma once
+
+#include "domain.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace babus {
+
+    //
+    // `AsyncPublisher` writes one slot's messages from a background thread. The producer hands over a buffer and moves
+    // on instead of waiting for the write lock and the copy of a big frame. `ClientSlot::writeAsync()` keeps one per slot.
+    //
+    // Messages are published in order. At most `maxQueued` wait at a time. One more drops the oldest waiting one: the
+    // slot only holds the latest message, so readers would most likely have skipped it anyway. Every message reports
+    // whether it was published, through its callback or future. Callbacks of published messages run on the publisher
+    // thread. Callbacks of dropped ones run on the thread whose `write` dropped them.
+    //
+    // Buffers come back, so a producer of big frames does not allocate one per message: the callback gets the buffer,
+    // and buffers written without a callback (or with a future) are kept for `takeBuffer()`.
+    //
+    // NOTE: The `Slot` and `Domain` must outlive the `AsyncPublisher`.
+    //
+
+    class AsyncPublisher {
+    public:
+        // Gets the buffer back, published or not.
+        using Done = std::function<void(bool published, std::vector<uint8_t>&& buffer)>;
+
+        AsyncPublisher(Slot* slot, Domain* domain, uint32_t maxQueued = 2);
+        // Publishes what is still queued, then joins the thread.
+        ~AsyncPublisher();
+        AsyncPublisher(const AsyncPublisher&)            = delete;
+        AsyncPublisher& operator=(const AsyncPublisher&) = delete;
+
+        void write(std::vector<uint8_t>&& buffer, Done done);
+        // The future is true once published, false if dropped.
+        std::future<bool> write(std::vector<uint8_t>&& buffer);
+
+        // A buffer of an earlier message that is done, still holding its bytes, or an empty one if none is free. Resize it
+        // and fill it with the next message.
+        std::vector<uint8_t> takeBuffer();
+
+        // Blocks until everything written so far is published or dropped.
+        void flush();
+
+        // Messages waiting, not counting the one being written.
+        uint32_t queued();
+        inline uint32_t maxQueued() const {
+            return maxQueued_;
+        }
+        inline uint64_t published() const {
+            return published_.load();
+        }
+        inline uint64_t dropped() const {
+            return dropped_.load();
+        }
+
+    private:
+        struct Pending {
+            std::vector<uint8_t> buffer;
+            Done done;
+        };
+
+        void loop();
+        // Ends a message: hands the buffer to `done`, or keeps it for `takeBuffer()`.
+        void finish(bool published, Pending&& pending);
+
+        Slot* slot_;
+        Domain* domain_;
+        const uint32_t maxQueued_;
+
+        std::mutex mtx_;
+        std::condition_variable workCv_, idleCv_;
+        std::deque<Pending> queue_;
+        std::vector<std::vector<uint8_t>> freeBuffers_; // At most `maxQueued_ + 1`: enough for a producer that keeps up.
+        bool writing_ = false;
+        bool stop_    = false;
+
+        std::atomic<uint64_t> published_ { 0 };
+        std::atomic<uint64_t> dropped_ { 0 };
+
+        std::thread thread_;
+    };
+
+}
@@ -0,0 +1,94 @@
+#include "snapshot.h"
+
+#include <algorithm>
+#include <sched.h>
+
+namespace babus {
+
+    namespace {
+
+        // Sum of lengths, with each length clamped: an optimistic reader may see a torn `length`.
+        void layoutItems(Snapshot& out, const std::vector<uint32_t>& lengths) {
+            std::size_t total = 0;
+            for (auto len : lengths) total += std::min<std::size_t>(len, SlotDataCapacity);
+            out.buffer.resize(total);
+
+            std::size_t offset = 0;
+            for (std::size_t i = 0; i < out.items.size(); i++) {
+                std::size_t len    = std::min<std::size_t>(lengths[i], SlotDataCapacity);
+                out.items[i].span = ByteSpan { out.buffer.data() + offset, len };
+                offset += len;
+            }
+        }
+
+        void copyItems(Snapshot& out) {
+            for (auto& item : out.items) {
+                if (item.span.len > 0) copyBytes(item.span.ptr, item.slot->data_ptr(), item.span.len);
+            }
+        }
+
+        bool tryOptimistic(Snapshot& out, std::vector<uint32_t>& lengths) {
+            for (std::size_t i = 0; i < out.items.size(); i++) {
+                Slot* slot = out.items[i].slot;
+                if (slot->mtx.isWriteLocked()) return false;
+                out.items[i].seq = slot->seq.load();
+                lengths[i]       = slot->length;
+            }
+
+            layoutItems(out, lengths);
+            copyItems(out);
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            // Validate: no slot may have been written (seq changed) or be in the middle of a write.
+            for (const auto& item : out.items) {
+                if (item.slot->seq.load() != item.seq) return false;
+                if (item.slot->mtx.isWriteLocked()) return false;
+            }
+            return true;
+        }
+
+        void readLocked(Snapshot& out, std::vector<uint32_t>& lengths) {
+            std::vector<Slot*> order;
+            for (const auto& item : out.items) order.push_back(item.slot);
+            std::sort(order.begin(), order.end());
+            order.erase(std::unique(order.begin(), order.end()), order.end());
+
+            std::vector<RwMutexReadLockGuard> locks;
+            locks.reserve(order.size());
+            for (Slot* slot : order) locks.emplace_back(slot->getReadLock());
+
+            for (std::size_t i = 0; i < out.items.size(); i++) {
+                out.items[i].seq = out.items[i].slot->seq.load();
+                lengths[i]       = out.items[i].slot->length;
+            }
+            layoutItems(out, lengths);
+            copyItems(out);
+        }
+
+    }
+
+    Snapshot readSnapshot(const std::vector<Slot*>& slots, uint32_t maxOptimisticTries) {
+        Snapshot out;
+        out.items.resize(slots.size());
+        for (std::size_t i = 0; i < slots.size(); i++) {
+            assert(slots[i] != nullptr);
+            out.items[i].slot = slots[i];
+        }
+
+        std::vector<uint32_t> lengths(slots.size());
+
+        while (out.tries < maxOptimisticTries) {
+            out.tries++;
+            if (tryOptimistic(out, lengths)) return out;
+            SPDLOG_TRACE("readSnapshot optimistic try {} failed validation.", out.tries);
+            sched_yield();
+        }
+
+        SPDLOG_DEBUG("readSnapshot failed {} optimistic tries, falling back to read locks.", out.tries);
+        out.tries++;
+        out.usedLocks = true;
+        readLocked(out, lengths);
+        return out;
+    }
+
+}
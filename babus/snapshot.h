@@ -0,0 +1,52 @@
+#pragma once
+
+#include "domain.h"
+
+#include <initializer_list>
+#include <vector>
+
+namespace babus {
+
+    //
+    // A `Snapshot` is a copy of several `Slot`s that all correspond to one point in time.
+    //
+    // Reading `pose`, `velocity` and `mode` with three separate `Slot::read()` calls can observe a
+    // combination that never existed, because a writer may update `pose` in between the reads.
+    //
+    // `readSnapshot` avoids that without taking every slot's lock: it samples each sequence counter,
+    // copies all of the data, then validates (seqlock style) that no slot was written or write-locked
+    // in the meantime. On failure it retries. After `maxOptimisticTries` failed attempts it falls back
+    // to holding every read lock at once (acquired in address order, so concurrent snapshots cannot
+    // deadlock), so that a fast writer can never starve a snapshot reader.
+    //
+    // This is meant for small correlated state. The data are copied on every attempt.
+    //
+
+    struct SnapshotItem {
+        Slot* slot   = nullptr;
+        uint32_t seq = 0;
+        ByteSpan span; // Points into `Snapshot::buffer`.
+    };
+
+    struct Snapshot {
+        std::vector<SnapshotItem> items;
+        std::vector<uint8_t> buffer;
+
+        uint32_t tries = 0;     // How many attempts were made, including the locked fallback.
+        bool usedLocks = false; // True if the optimistic reads never validated.
+
+        inline std::size_t size() const {
+            return items.size();
+        }
+        inline const SnapshotItem& operator[](std::size_t i) const {
+            return items[i];
+        }
+    };
+
+    Snapshot readSnapshot(const std::vector<Slot*>& slots, uint32_t maxOptimisticTries = 8);
+
+    inline Snapshot readSnapshot(std::initializer_list<Slot*> slots, uint32_t maxOptimisticTries = 8) {
+        return readSnapshot(std::vector<Slot*>(slots), maxOptimisticTries);
+    }
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "babus/common.h"
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+
+namespace babus {
+
+    //
+    // Per-slot performance counters, kept in the slot file between the header and the data
+    // (at `SlotStatsOffset`), so any process can read them while traffic continues.
+    //
+    // The block is always reserved, but it is only updated when babus is built with `BABUS_SLOT_STATS`
+    // (meson option `-Dslot_stats=enabled`). All updates are relaxed atomics: counters are exact, but a
+    // reader may see e.g. `writes` and `bytesWritten` from slightly different moments.
+    //
+    // Times are `CLOCK_MONOTONIC` nanoseconds, which is comparable across processes.
+    //
+
+    inline int64_t monotonicNanos() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return int64_t(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+    }
+
+    // Bucket `i` counts values in [2^(i-1), 2^i) nanoseconds; bucket 0 counts zero.
+    struct Log2Histogram {
+        static constexpr uint32_t NumBuckets = 40; // up to ~9 minutes.
+
+        std::atomic<uint64_t> buckets[NumBuckets];
+
+        static inline uint32_t bucketOf(int64_t nanos) {
+            if (nanos <= 0) return 0;
+            uint32_t b = 64 - __builtin_clzll(uint64_t(nanos));
+            return b < NumBuckets ? b : NumBuckets - 1;
+        }
+
+        // Upper bound of bucket `b`.
+        static inline int64_t bucketLimit(uint32_t b) {
+            return b == 0 ? 0 : (int64_t(1) << b);
+        }
+
+        inline void record(int64_t nanos) {
+            buckets[bucketOf(nanos)].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        inline uint64_t count() const {
+            uint64_t n = 0;
+            for (const auto& b : buckets) n += b.load(std::memory_order_relaxed);
+            return n;
+        }
+
+        // Upper bound of the bucket holding the `q`-th quantile (`q` in [0, 1]). Zero if empty.
+        inline int64_t quantile(double q) const {
+            uint64_t n = count();
+            if (n == 0) return 0;
+            uint64_t target = uint64_t(q * double(n - 1)) + 1, seen = 0;
+            for (uint32_t b = 0; b < NumBuckets; b++) {
+                seen += buckets[b].load(std::memory_order_relaxed);
+                if (seen >= target) return bucketLimit(b);
+            }
+            return bucketLimit(NumBuckets - 1);
+        }
+    };
+
+    struct SlotStats {
+        std::atomic<uint64_t> writes;
+        std::atomic<uint64_t> bytesWritten;
+        std::atomic<uint64_t> reads;       // Read locks taken (`Slot::read()`).
+        std::atomic<uint64_t> futexWakes;  // Wakes issued on the domain counter for this slot.
+        std::atomic<uint64_t> futexWaits;  // `Waiter::waitExclusive` calls that waited on this slot.
+        std::atomic<int64_t> lastPublishNanos;
+
+        Log2Histogram writeLockWaitNanos; // Time to acquire the write lock.
+        Log2Histogram writeLockHoldNanos; // Time the write lock was held.
+        Log2Histogram publishToReadNanos; // Publish until a `Waiter` visited the new data.
+    };
+
+    static_assert(SlotStatsOffset + sizeof(SlotStats) <= SlotAttachOffset, "SlotStats does not fit before SlotAttachOffset");
+
+#ifdef BABUS_SLOT_STATS
+    constexpr bool SlotStatsEnabled = true;
+#else
+    constexpr bool SlotStatsEnabled = false;
+#endif
+
+}
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+
+#include "babus/coro.h"
+#include "babus/test/fixtures.h"
+
+#include <thread>
+
+using namespace babus;
+using namespace babus::test;
+
+namespace {
+	CoroTask consumeUntil(Slot* slot, uint32_t lastSeq, int& nWakes) {
+		uint32_t seq = slot->seq.load();
+		while (seq < lastSeq) {
+			seq = co_await nextAfter(slot, seq);
+			auto view = slot->read();
+			EXPECT_EQ(view.span.len, sizeof(uint32_t));
+			nWakes++;
+		}
+	}
+
+	CoroTask consumeWithWaiter(Waiter& waiter, int nMessages, int& nSeen) {
+		while (nSeen < nMessages) {
+			co_await next(waiter);
+			waiter.forEachNewSlot([&](LockedView&&) { nSeen++; });
+		}
+	}
+}
+
+TEST(Coro, ManyConsumersOneThread) {
+	Domain* domain = malloc_domain();
+	Slot* slot = malloc_slot();
+
+	static constexpr int NumConsumers = 200;
+	static constexpr uint32_t NumMessages = 20;
+
+	std::vector<int> nWakes(NumConsumers, 0);
+	CoroExecutor ex(domain);
+	for (int i = 0; i < NumConsumers; i++) ex.spawn(consumeUntil(slot, NumMessages, nWakes[i]));
+
+	std::thread producer([&]() {
+		for (uint32_t i = 0; i < NumMessages; i++) {
+			usleep(2'000);
+			slot->write(domain, {&i, sizeof(i)});
+		}
+	});
+
+	ex.run();
+	producer.join();
+
+	EXPECT_EQ(ex.numTasks(), 0);
+	for (int n : nWakes) {
+		EXPECT_GT(n, 0);
+		EXPECT_LE(n, NumMessages);
+	}
+
+	free(slot);
+	free(domain);
+}
+
+TEST(Coro, WaiterNext) {
+	Domain* domain = malloc_domain();
+	Slot* slot = malloc_slot();
+
+	Waiter waiter(domain);
+	waiter.subscribeTo(slot, true);
+
+	int nSeen = 0;
+	CoroExecutor ex(domain);
+	ex.spawn(consumeWithWaiter(waiter, 3, nSeen));
+
+	std::thread producer([&]() {
+		for (uint32_t i = 0; i < 3; i++) {
+			usleep(5'000);
+			slot->write(domain, {&i, sizeof(i)});
+		}
+	});
+
+	ex.run();
+	producer.join();
+	EXPECT_EQ(nSeen, 3);
+
+	free(slot);
+	free(domain);
+}
+
+TEST(Coro, StopFromAnotherThreadLeavesDomainAlone) {
+	Domain* domain = malloc_domain();
+	Slot* slot = malloc_slot();
+
+	int nWakes = 0;
+	CoroExecutor ex(domain);
+	ex.spawn(consumeUntil(slot, 1, nWakes));
+
+	std::thread stopper([&]() {
+		usleep(5'000);
+		ex.stop();
+	});
+	ex.run();
+	stopper.join();
+
+	// Stopping must not bump the shared counter: that would wake other processes subscribed to the same bits.
+	EXPECT_EQ(domain->seq.load(), 0u);
+	EXPECT_EQ(nWakes, 0);
+
+	free(slot);
+	free(domain);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "babus/domain.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace babus {
+namespace test {
+	// Simpler than setting up with ClientDomain + mmaps and all of that.
+	// Zeroed like a fresh tmpfs file, so the trace ring, `SlotStats` block and the slot tables start empty.
+	inline Domain* malloc_domain() {
+		void* p = calloc(1, DomainFileSize);
+		new (p) Domain{};
+		return (Domain*) p;
+	}
+	inline Slot* malloc_slot() {
+		void* p = calloc(1, SlotFileSize);
+		new (p) Slot{};
+		return (Slot*) p;
+	}
+}
+}
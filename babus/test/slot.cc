@@ -0,0 +1,581 @@
+#include <gtest/gtest.h>
+
+#include "babus/domain.h"
+#include "babus/publisher.h"
+#include "babus/snapshot.h"
+#include "babus/typed.h"
+#include "babus/test/fixtures.h"
+
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+using namespace babus;
+using namespace babus::test;
+
+namespace {
+	uint64_t readCounter(const SnapshotItem& item) {
+		uint64_t v = 0;
+		if (item.span.len == sizeof(v)) memcpy(&v, item.span.ptr, sizeof(v));
+		return v;
+	}
+}
+
+TEST(Snapshot, LockedFallbackCopiesAllSlots) {
+	Domain* domain = malloc_domain();
+	Slot* a = malloc_slot();
+	Slot* b = malloc_slot();
+
+	uint64_t va = 1, vb = 2;
+	a->write(domain, {&va, sizeof(va)});
+	b->write(domain, {&vb, sizeof(vb)});
+
+	Snapshot snap = readSnapshot({a, b}, 0);
+	EXPECT_TRUE(snap.usedLocks);
+	ASSERT_EQ(snap.size(), 2);
+	EXPECT_EQ(readCounter(snap[0]), 1);
+	EXPECT_EQ(readCounter(snap[1]), 2);
+	EXPECT_EQ(snap[0].seq, a->seq.load());
+
+	free(a);
+	free(b);
+	free(domain);
+}
+
+TEST(Snapshot, NeverSeesTornCombination) {
+	// The writer always writes `a` then `b` with the same counter value.
+	// So any real point in time has `a == b` or `a == b + 1`.
+	Domain* domain = malloc_domain();
+	Slot* a = malloc_slot();
+	Slot* b = malloc_slot();
+
+	std::atomic<bool> stop = false;
+	std::thread writer([&]() {
+		for (uint64_t i = 1; !stop.load(); i++) {
+			a->write(domain, {&i, sizeof(i)});
+			b->write(domain, {&i, sizeof(i)});
+		}
+	});
+
+	int n_optimistic = 0;
+	for (int i = 0; i < 20'000; i++) {
+		Snapshot snap = readSnapshot({a, b});
+		uint64_t va = readCounter(snap[0]), vb = readCounter(snap[1]);
+		ASSERT_LE(vb, va);
+		ASSERT_LE(va, vb + 1);
+		if (!snap.usedLocks) n_optimistic++;
+	}
+
+	stop = true;
+	writer.join();
+	EXPECT_GT(n_optimistic, 0);
+
+	free(a);
+	free(b);
+	free(domain);
+}
+
+TEST(Slot, WritevConcatenatesAndReadvScatters) {
+	Domain* domain = malloc_domain();
+	Slot* slot = malloc_slot();
+
+	struct Header { uint32_t width, height; } header { 4, 2 };
+	uint8_t plane[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+	const char meta[] = "cam0";
+	slot->writev(domain, { { &header, sizeof(header) }, { plane, sizeof(plane) }, { (void*)meta, sizeof(meta) } });
+	EXPECT_EQ(slot->length, sizeof(header) + sizeof(plane) + sizeof(meta));
+	EXPECT_EQ(slot->seq.load(), 1);
+
+	Header h {};
+	uint8_t secondRow[4] = {};
+	char m[16] = {};
+	{
+		auto view = slot->read();
+		std::size_t n = view.readv({ { 0, { &h, sizeof(h) } }, { sizeof(h) + 4, { secondRow, sizeof(secondRow) } },
+			{ sizeof(h) + sizeof(plane), { m, sizeof(m) } }, { 1000, { m, sizeof(m) } } });
+		// The metadata range is cut at the end of the message, the last one is past it.
+		EXPECT_EQ(n, sizeof(h) + sizeof(secondRow) + sizeof(meta));
+	}
+	EXPECT_EQ(h.width, 4);
+	EXPECT_EQ(h.height, 2);
+	EXPECT_EQ(secondRow[0], 5);
+	EXPECT_EQ(secondRow[3], 8);
+	EXPECT_STREQ(m, "cam0");
+
+	free(slot);
+	free(domain);
+}
+
+TEST(Slot, ImageRegionsAndDownsampling) {
+	Domain* domain = malloc_domain();
+	Slot* slot = malloc_slot();
+
+	// 6x4 Gray8 with two bytes of row padding. Pixel (x, y) is 10 * y + x.
+	ImageLayout layout { 6, 4, 8, PixelFormat::Gray8 };
+	uint8_t pixels[32] = {};
+	for (uint32_t y = 0; y < 4; y++)
+		for (uint32_t x = 0; x < 6; x++) pixels[y * 8 + x] = 10 * y + x;
+	slot->writeImage(domain, layout, { pixels, sizeof(pixels) });
+	EXPECT_EQ(slot->length, layout.byteSize());
+
+	{
+		auto view = slot->read();
+		ImageView image = view.imageView();
+		ASSERT_TRUE(image.valid());
+		EXPECT_EQ(view.image.width, 6);
+
+		uint8_t roi[6] = {};
+		EXPECT_EQ(image.copyRegion({ 2, 1, 3, 2 }, roi, sizeof(roi)), 6);
+		EXPECT_EQ(roi[0], 12);
+		EXPECT_EQ(roi[2], 14);
+		EXPECT_EQ(roi[3], 22);
+		EXPECT_EQ(roi[5], 24);
+
+		// Clipped to the image.
+		EXPECT_EQ(image.copyRegion({ 4, 3, 10, 10 }, roi, sizeof(roi)), 2);
+		EXPECT_EQ(roi[0], 34);
+		EXPECT_EQ(roi[1], 35);
+
+		uint8_t small[6] = {};
+		EXPECT_EQ(image.downsampledLayout(2).width, 3);
+		EXPECT_EQ(image.downsampledLayout(2).height, 2);
+		EXPECT_EQ(image.copyDownsampled(2, small, sizeof(small)), 6);
+		EXPECT_EQ(small[1], 2);
+		EXPECT_EQ(small[3], 20);
+		EXPECT_EQ(small[5], 24);
+	}
+
+	// A plain write is not an image.
+	slot->write(domain, { pixels, sizeof(pixels) });
+	EXPECT_FALSE(slot->read().imageView().valid());
+
+	free(slot);
+	free(domain);
+}
+
+TEST(CopyBytes, StreamingMatchesMemcpyAtAnyAlignment) {
+	std::size_t before = streamingCopyThreshold();
+	setStreamingCopyThreshold(1);
+
+	std::vector<uint8_t> src(1 << 16), dst((1 << 16) + 128), want(dst.size());
+	for (std::size_t i = 0; i < src.size(); i++) src[i] = uint8_t(i * 7 + 3);
+	for (std::size_t offset : { 0, 1, 17, 63 })
+		for (std::size_t len : { 257, 1000, 4096, 65000 }) {
+			std::fill(dst.begin(), dst.end(), 0xee);
+			want = dst;
+			std::memcpy(want.data() + offset, src.data() + 5, len);
+			copyBytes(dst.data() + offset, src.data() + 5, len);
+			EXPECT_EQ(dst, want) << "offset " << offset << " len " << len << " kernel " << copyKernelName();
+		}
+
+	setStreamingCopyThreshold(before);
+}
+
+TEST(CopyBytes, ParallelCopyMatchesMemcpy) {
+	setParallelCopy(3, 1);
+	EXPECT_EQ(parallelCopyHelpers(), 3);
+
+	std::vector<uint8_t> src(3 << 20), dst(src.size() + 4096), want(dst.size());
+	for (std::size_t i = 0; i < src.size(); i++) src[i] = uint8_t(i * 7 + 3);
+	for (std::size_t offset : { 0, 1, 4095 })
+		for (std::size_t len : { 300, 9000, 1 << 20, 3 << 20 }) {
+			std::fill(dst.begin(), dst.end(), 0xee);
+			want = dst;
+			std::memcpy(want.data() + offset, src.data(), len);
+			copyBytes(dst.data() + offset, src.data(), len);
+			EXPECT_EQ(dst, want) << "offset " << offset << " len " << len;
+		}
+
+	// Concurrent copies share the pool or fall back to copying alone.
+	std::vector<uint8_t> other(dst.size());
+	std::thread t([&] { for (int i = 0; i < 20; i++) copyBytes(other.data(), src.data(), src.size()); });
+	for (int i = 0; i < 20; i++) copyBytes(dst.data(), src.data(), src.size());
+	t.join();
+	EXPECT_TRUE(std::equal(src.begin(), src.end(), dst.begin()));
+	EXPECT_TRUE(std::equal(src.begin(), src.end(), other.begin()));
+
+	setParallelCopy(0);
+	EXPECT_EQ(parallelCopyHelpers(), 0);
+}
+
+TEST(CopyBytes, ForkedChildCopiesWithoutThePool) {
+	setParallelCopy(2, 1);
+	std::vector<uint8_t> src(3 << 20), dst(src.size());
+	for (std::size_t i = 0; i < src.size(); i++) src[i] = uint8_t(i * 7 + 3);
+
+	// Keep the helpers busy so one of them may hold the pool's mutex at the fork.
+	std::atomic<bool> stop { false };
+	std::vector<uint8_t> other(src.size());
+	std::thread t([&] { while (!stop) copyBytes(other.data(), src.data(), src.size()); });
+	for (int i = 0; i < 20; i++) {
+		pid_t pid = fork();
+		if (pid == 0) {
+			copyBytes(dst.data(), src.data(), src.size());
+			_exit(dst == src ? 0 : 1);
+		}
+		int status = -1;
+		waitpid(pid, &status, 0);
+		EXPECT_TRUE(WIFEXITED(status) and WEXITSTATUS(status) == 0);
+	}
+	stop = true;
+	t.join();
+
+	setParallelCopy(0);
+}
+
+TEST(AsyncPublisher, PublishesInOrderAndDropsOldest) {
+	Domain* domain = malloc_domain();
+	Slot* slot = malloc_slot();
+	bool lastPublished = false;
+	{
+		AsyncPublisher publisher { slot, domain, 2 };
+
+		// Hold the write lock so the first message stays in flight while more queue up behind it.
+		std::future<bool> first, second, third, fourth;
+		{
+			auto lck = slot->getWriteLock();
+			first = publisher.write(std::vector<uint8_t>(100, 1));
+			while (publisher.queued() > 0) std::this_thread::yield();
+			second = publisher.write(std::vector<uint8_t>(200, 2));
+			third = publisher.write(std::vector<uint8_t>(300, 3));
+			fourth = publisher.write(std::vector<uint8_t>(400, 4));
+			EXPECT_EQ(publisher.queued(), 2);
+			EXPECT_EQ(second.wait_for(std::chrono::seconds(0)), std::future_status::ready);
+		}
+		publisher.flush();
+
+		EXPECT_TRUE(first.get());
+		EXPECT_FALSE(second.get());
+		EXPECT_TRUE(third.get());
+		EXPECT_TRUE(fourth.get());
+		EXPECT_EQ(publisher.published(), 3);
+		EXPECT_EQ(publisher.dropped(), 1);
+		EXPECT_EQ(slot->seq.load(), 3);
+		EXPECT_EQ(slot->length, 400);
+		EXPECT_EQ(slot->data_ptr()[0], 4);
+
+		// Queued messages are still published when the publisher goes away.
+		publisher.write(std::vector<uint8_t>(50, 5), [&](bool ok, std::vector<uint8_t>&&) { lastPublished = ok; });
+	}
+	EXPECT_TRUE(lastPublished);
+	EXPECT_EQ(slot->length, 50);
+
+	free(slot);
+	free(domain);
+}
+
+TEST(AsyncPublisher, HandsBuffersBack) {
+	Domain* domain = malloc_domain();
+	Slot* slot = malloc_slot();
+	AsyncPublisher publisher { slot, domain, 2 };
+
+	// Through the callback.
+	std::vector<uint8_t> back;
+	std::vector<uint8_t> buffer(1000, 1);
+	const uint8_t* data = buffer.data();
+	publisher.write(std::move(buffer), [&](bool ok, std::vector<uint8_t>&& b) { back = std::move(b); });
+	publisher.flush();
+	EXPECT_EQ(back.data(), data);
+
+	// Kept for `takeBuffer()` otherwise.
+	EXPECT_TRUE(publisher.takeBuffer().empty());
+	publisher.write(std::move(back)).get();
+	std::vector<uint8_t> reused = publisher.takeBuffer();
+	EXPECT_EQ(reused.data(), data);
+	EXPECT_EQ(reused.size(), 1000);
+
+	free(slot);
+	free(domain);
+}
+
+TEST(SlotStats, Log2HistogramQuantiles) {
+	Log2Histogram h {};
+	EXPECT_EQ(h.quantile(0.5), 0);
+	for (int i = 0; i < 90; i++) h.record(100);   // bucket [64, 128)
+	for (int i = 0; i < 10; i++) h.record(5000);  // bucket [4096, 8192)
+	EXPECT_EQ(h.count(), 100);
+	EXPECT_EQ(h.quantile(0.5), 128);
+	EXPECT_EQ(h.quantile(0.95), 8192);
+	EXPECT_EQ(h.quantile(1.0), 8192);
+}
+
+TEST(SlotStats, CountsWritesAndReads) {
+	if (!SlotStatsEnabled) GTEST_SKIP() << "built without BABUS_SLOT_STATS";
+
+	Domain* domain = malloc_domain();
+	Slot* slot = malloc_slot();
+
+	uint64_t v = 0;
+	for (int i = 0; i < 5; i++) slot->write(domain, {&v, sizeof(v)});
+	auto wv = slot->beginWrite(domain);
+	wv.commit(3);
+	{ auto view = slot->read(); }
+
+	const SlotStats& s = slot->stats();
+	EXPECT_EQ(s.writes.load(), 6);
+	EXPECT_EQ(s.bytesWritten.load(), 5 * sizeof(v) + 3);
+	EXPECT_EQ(s.reads.load(), 1);
+	EXPECT_EQ(s.futexWakes.load(), 6);
+	EXPECT_EQ(s.writeLockHoldNanos.count(), 6);
+	EXPECT_GT(s.lastPublishNanos.load(), 0);
+
+	free(slot);
+	free(domain);
+}
+
+TEST(Trace, RecordsLockAndPublish) {
+	Domain* domain = malloc_domain();
+	Slot* slot = malloc_slot();
+	slot->index = 3;
+
+	uint64_t v = 0;
+	slot->write(domain, {&v, sizeof(v)});
+	EXPECT_EQ(domain->trace().head.load(), 0);
+
+	domain->trace().enabled = 1;
+	slot->write(domain, {&v, sizeof(v)});
+	auto wv = slot->beginWrite(domain);
+	wv.commit(3);
+
+	TraceRing& ring = domain->trace();
+	ASSERT_EQ(ring.head.load(), 4);
+	EXPECT_EQ(ring.records[0].event, TraceEvent::WriteLock);
+	EXPECT_EQ(ring.records[1].event, TraceEvent::Publish);
+	EXPECT_EQ(ring.records[1].slot, 3);
+	EXPECT_EQ(ring.records[1].seq, 2);
+	EXPECT_EQ(ring.records[1].arg, sizeof(v));
+	EXPECT_EQ(ring.records[3].arg, 3);
+	EXPECT_EQ(ring.records[3].pid, getpid());
+	for (uint32_t i = 0; i < 4; i++) EXPECT_EQ(ring.records[i].stamp.load(), i + 1);
+	EXPECT_GE(ring.records[3].ticks, ring.records[0].ticks);
+
+	free(slot);
+	free(domain);
+}
+
+TEST(RobustLock, RecoversFromDeadWriterAndReader) {
+	// Shared with the forked children, like a real slot file.
+	Domain* domain = malloc_domain();
+	void* p = mmap(nullptr, SlotFileSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	ASSERT_NE(p, MAP_FAILED);
+	Slot* slot = new (p) Slot{};
+
+	uint64_t v = 7;
+	slot->write(domain, {&v, sizeof(v)});
+
+	// A writer dies mid-write: the data is gone, but the slot is usable again.
+	pid_t pid = fork();
+	if (pid == 0) {
+		auto wv = slot->beginWrite(domain);
+		memset(wv.span.ptr, 0xff, 16);
+		_exit(0);
+	}
+	waitpid(pid, nullptr, 0);
+	EXPECT_TRUE(slot->mtx.isWriteLocked());
+	{
+		auto view = slot->read();
+		EXPECT_TRUE(view.invalidated);
+		EXPECT_EQ(view.span.len, 0);
+	}
+	EXPECT_EQ(slot->lockOwners().writerRecoveries.load(), 1);
+
+	// A reader dies holding its view: writers take the lock back, and the data stays valid.
+	pid = fork();
+	if (pid == 0) {
+		auto view = slot->read();
+		_exit(0);
+	}
+	waitpid(pid, nullptr, 0);
+	EXPECT_EQ(slot->mtx.load(), 2);
+	v = 8;
+	slot->write(domain, {&v, sizeof(v)});
+	EXPECT_EQ(slot->lockOwners().readerRecoveries.load(), 1);
+	{
+		auto view = slot->read();
+		EXPECT_FALSE(view.invalidated);
+		ASSERT_EQ(view.span.len, sizeof(v));
+		EXPECT_EQ(memcmp(view.span.ptr, &v, sizeof(v)), 0);
+	}
+	EXPECT_EQ(slot->mtx.load(), 1);
+
+	munmap(p, SlotFileSize);
+	free(domain);
+}
+
+TEST(RobustLock, KeepsReadHoldOfViewMovedToAnotherThread) {
+	Domain* domain = malloc_domain();
+	Slot* slot = malloc_slot();
+	uint64_t v = 7;
+	slot->write(domain, {&v, sizeof(v)});
+
+	// Locked by a thread that has exited since, released later by this one, like a view a `Dispatcher` worker runs.
+	std::optional<LockedView> view;
+	std::thread([&] { view.emplace(slot->read()); }).join();
+
+	// A writer stalls for several timeouts, but the hold belongs to a live process.
+	std::atomic<bool> wrote { false };
+	std::thread writer([&] {
+		uint64_t w = 8;
+		slot->write(domain, {&w, sizeof(w)});
+		wrote = true;
+	});
+	usleep(350'000);
+	EXPECT_FALSE(wrote);
+	EXPECT_EQ(slot->lockOwners().readerRecoveries.load(), 0);
+
+	view.reset();
+	writer.join();
+	EXPECT_TRUE(wrote);
+	EXPECT_EQ(slot->mtx.load(), 1);
+
+	free(slot);
+	free(domain);
+}
+
+TEST(RobustLock, OwnersInOtherPidNamespacesCountAsAlive) {
+	pid_t pid = fork();
+	if (pid == 0) _exit(0);
+	waitpid(pid, nullptr, 0);
+
+	EXPECT_TRUE(LockOwners::ownerIsDead(LockOwners::ownerOf(pid)));
+	// The same pid in a container's namespace may well be running.
+	uint64_t elsewhere = uint64_t(LockOwners::pidNamespace() + 1) << 32 | uint32_t(pid);
+	EXPECT_FALSE(LockOwners::ownerIsDead(elsewhere));
+}
+
+TEST(RobustLock, RecoversSlotRegistryFromDeadWriter) {
+	void* p = mmap(nullptr, sizeof(Domain), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	ASSERT_NE(p, MAP_FAILED);
+	Domain* domain = new (p) Domain{};
+
+	pid_t pid = fork();
+	if (pid == 0) {
+		auto lck = domain->getSlotsWriteLock();
+		_exit(0);
+	}
+	waitpid(pid, nullptr, 0);
+	EXPECT_TRUE(domain->slotMtx.isWriteLocked());
+
+	EXPECT_EQ(domain->registerSlot("afterCrash"), 0);
+	EXPECT_EQ(domain->slotMtxOwners.writerRecoveries.load(), 1);
+	EXPECT_EQ(domain->slotMtx.load(), 1);
+
+	munmap(p, sizeof(Domain));
+}
+
+TEST(AttachTable, OverflowAttachesOfDeadProcessesClear) {
+	void* p = mmap(nullptr, sizeof(AttachTable), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	ASSERT_NE(p, MAP_FAILED);
+	AttachTable* at = new (p) AttachTable{};
+	const int32_t self = getpid();
+
+	std::vector<int> mine;
+	for (uint32_t i = 0; i < AttachTable::MaxEntries; i++) mine.push_back(at->attach(self));
+
+	// A process that finds the table full and dies without detaching.
+	pid_t pid = fork();
+	if (pid == 0) {
+		for (int i = 0; i < 3; i++) at->attach(getpid());
+		_exit(0);
+	}
+	waitpid(pid, nullptr, 0);
+
+	// Ours overflow too, counted in one entry, and detach again.
+	int a = at->attach(self), b = at->attach(self);
+	EXPECT_GE(a, int(AttachTable::MaxEntries));
+	EXPECT_EQ(a, b);
+	EXPECT_EQ(at->numAlive(), AttachTable::MaxEntries + 2);
+	at->detach(a);
+	at->detach(b);
+
+	for (int i : mine) at->detach(i);
+	EXPECT_EQ(at->numAlive(), 0);
+	EXPECT_TRUE(at->markRemoved(false));
+
+	munmap(p, sizeof(AttachTable));
+}
+
+TEST(SlotMemory, ReleasesPagesBeyondShrunkMessages) {
+	// Shared memory like a slot file, so MADV_REMOVE really frees it.
+	Domain* domain = malloc_domain();
+	void* p = mmap(nullptr, SlotFileSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	ASSERT_NE(p, MAP_FAILED);
+	Slot* slot = new (p) Slot{};
+	slot->trimAfterNanos = 1'000'000;
+
+	std::vector<uint8_t> big(4 << 20, 1), small(1024, 2);
+	slot->write(domain, {big.data(), big.size()});
+	std::size_t residentBig = slot->residentBytes();
+	EXPECT_GE(residentBig, big.size());
+	EXPECT_EQ(slot->highWater, big.size());
+
+	// The window that saw the big message passes without releasing anything, the next one releases.
+	usleep(2000);
+	slot->write(domain, {small.data(), small.size()});
+	EXPECT_EQ(slot->trimmedBytes, 0);
+	usleep(2000);
+	slot->write(domain, {small.data(), small.size()});
+	EXPECT_EQ(slot->highWater, small.size());
+	EXPECT_GE(slot->trimmedBytes, big.size() - 8192);
+	EXPECT_LE(slot->residentBytes() + big.size() - 8192, residentBig);
+
+	{
+		auto view = slot->read();
+		ASSERT_EQ(view.span.len, small.size());
+		EXPECT_EQ(memcmp(view.span.ptr, small.data(), small.size()), 0);
+	}
+
+	munmap(p, SlotFileSize);
+	free(domain);
+}
+
+namespace {
+	struct Imu {
+		double accel[3];
+		double gyro[3];
+		int64_t stampNanos;
+	};
+	struct Pose {
+		double x, y, theta;
+	};
+	struct Named {
+		static constexpr const char* babusTypeName = "test.Named.v1";
+		int32_t v;
+	};
+}
+
+TEST(TypedSlot, WritesReadsAndChecksType) {
+	Domain* domain = malloc_domain();
+	Slot* a = malloc_slot();
+	Slot* b = malloc_slot();
+
+	TypedSlot<Imu> imu { a, domain };
+	EXPECT_FALSE(imu.read().valid());
+	imu.write(Imu { { 1, 2, 3 }, { 4, 5, 6 }, 7 });
+	{
+		auto view = imu.read();
+		ASSERT_TRUE(view.valid());
+		EXPECT_EQ(view->accel[2], 3);
+		EXPECT_EQ(view.copy().stampNanos, 7);
+	}
+	EXPECT_EQ(a->length, sizeof(Imu));
+	EXPECT_EQ(a->typeHash.load(), typeHash<Imu>());
+
+	// Same type attaches again, another type is refused.
+	TypedSlot<Imu> again { a, domain };
+	EXPECT_THROW((TypedSlot<Pose> { a, domain }), std::runtime_error);
+
+	TypedSlot<Pose> pose { b, domain };
+	pose.emplace(1.0, 2.0, 0.5);
+	EXPECT_EQ(pose.read()->theta, 0.5);
+
+	static_assert(typeHash<Imu>() != typeHash<Pose>());
+	static_assert(typeHash<Named>() == typeHash<Named>());
+
+	free(a);
+	free(b);
+	free(domain);
+}
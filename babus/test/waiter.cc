@@ -2,26 +2,18 @@
 
 #include "babus/waiter.h"
 #include "babus/client.h"
+#include "babus/dispatcher.h"
+#include "babus/graph.h"
+#include "babus/test/fixtures.h"
 
 #include <thread>
+#include <dirent.h>
 #include <unistd.h>
+#include <poll.h>
 #include <sys/wait.h>
 
 using namespace babus;
-
-namespace {
-	// Simpler than setting up with ClientDomain + mmaps and all of that.
-	Domain* malloc_domain() {
-		void* p = malloc(DomainFileSize);
-		new (p) Domain{};
-		return (Domain*) p;
-	}
-	Slot* malloc_slot() {
-		void* p = malloc(SlotFileSize);
-		new (p) Slot{};
-		return (Slot*) p;
-	}
-}
+using namespace babus::test;
 
 TEST(Waiter, WaiterWorksWithJustTwoThreads) {
 	
@@ -54,7 +46,537 @@ TEST(Waiter, WaiterWorksWithJustTwoThreads) {
 	free(domain);
 }
 
+TEST(Waiter, WaitsOnAllTargetsWithoutWakeWith) {
+	Domain* domain = malloc_domain();
+	Slot* slot = malloc_slot();
+
+	// Used to abort (or spin on EINVAL with NDEBUG): there were no `wakeWith` bits to wait on.
+	Waiter waiter(domain);
+	waiter.subscribeTo(slot, false);
+	EXPECT_EQ(waiter.wakeMask(), 0u);
+	EXPECT_EQ(waiter.waitMask(), slot->eventMask());
+
+	std::thread t([&]() {
+		usleep(5'000);
+		uint32_t v = 1;
+		slot->write(domain, {&v, sizeof(v)});
+	});
+	waiter.waitExclusive();
+	t.join();
+	EXPECT_EQ(waiter.forEachNewSlot([](LockedView&&) {}), 1u);
+
+	// Same for the poll fd: it used to register mask 0 and never became readable.
+	pollfd pfd { waiter.pollFd(), POLLIN, 0 };
+	uint32_t v = 2;
+	slot->write(domain, {&v, sizeof(v)});
+	EXPECT_EQ(poll(&pfd, 1, 1'000), 1);
+	waiter.drainPollFd();
+	EXPECT_EQ(waiter.forEachNewSlot([](LockedView&&) {}), 1u);
+
+	free(slot);
+	free(domain);
+}
+
+TEST(Waiter, TracksPublishLatency) {
+	Domain* domain = malloc_domain();
+	Slot* slot = malloc_slot();
+
+	Waiter waiter(domain);
+	waiter.subscribeTo(slot);
+	EXPECT_EQ(waiter.latency(slot), nullptr);
+	waiter.trackLatency();
+
+	int64_t beforeWrite = monotonicNanos();
+	uint64_t v = 7;
+	slot->write(domain, {&v, sizeof(v)});
+
+	int visited = 0;
+	auto check = [&](LockedView&& view) {
+		visited++;
+		EXPECT_EQ(view.publisherPid, getpid());
+		EXPECT_GE(view.publishNanos, beforeWrite);
+		EXPECT_LE(view.publishNanos, monotonicNanos());
+	};
+	waiter.forEachNewSlot(check);
+
+	// `beginWrite` / `commit` stamps the header too.
+	auto wv = slot->beginWrite(domain);
+	wv.commit(1);
+	waiter.forEachNewSlot(check);
+
+	EXPECT_EQ(visited, 2);
+	ASSERT_NE(waiter.latency(slot), nullptr);
+	EXPECT_EQ(waiter.latency(slot)->count(), 2);
+
+	free(slot);
+	free(domain);
+}
+
+TEST(Waiter, CountsSkippedMessagesAndReportsLag) {
+	Domain* domain = malloc_domain();
+	Slot* slot = malloc_slot();
+	uint64_t v = 0;
+
+	{
+		Waiter waiter(domain);
+		waiter.subscribeTo(slot);
+		waiter.registerConsumer("lagTest");
+
+		const ConsumerEntry& entry = slot->consumers().entries[0];
+		ASSERT_EQ(entry.state.load(), ConsumerEntry::Active);
+		EXPECT_STREQ(entry.name, "lagTest");
+
+		for (int i = 0; i < 3; i++) slot->write(domain, {&v, sizeof(v)});
+		EXPECT_EQ(slot->consumers().maxLag(slot->seq.load()), 3);
+
+		uint32_t skipped = 99;
+		waiter.forEachNewSlot([&](LockedView&&, uint32_t n) { skipped = n; });
+		EXPECT_EQ(skipped, 2);
+		EXPECT_EQ(slot->consumers().maxLag(slot->seq.load()), 0);
+
+		slot->write(domain, {&v, sizeof(v)});
+		waiter.forEachNewSlot([&](LockedView&&, uint32_t n) { skipped = n; });
+		EXPECT_EQ(skipped, 0);
+
+		EXPECT_EQ(waiter.counters(slot).delivered, 2);
+		EXPECT_EQ(waiter.counters(slot).skipped, 2);
+		EXPECT_EQ(waiter.totalSkipped(), 2);
+		EXPECT_EQ(entry.delivered.load(), 2);
+		EXPECT_EQ(entry.skipped.load(), 2);
+	}
+
+	// The entry is released with the subscription.
+	EXPECT_EQ(slot->consumers().entries[0].state.load(), ConsumerEntry::Free);
+
+	free(slot);
+	free(domain);
+}
+
+TEST(Waiter, PollFdBecomesReadableOnWrite) {
+	Domain* domain = malloc_domain();
+	Slot* slot = malloc_slot();
+
+	Waiter waiter(domain);
+	waiter.subscribeTo(slot, true);
+
+	pollfd pfd { waiter.pollFd(), POLLIN, 0 };
+	EXPECT_EQ(poll(&pfd, 1, 0), 0);
+
+	const char hello[] = "hello1\0";
+	slot->write(domain, {(void*)hello, 7});
+	slot->write(domain, {(void*)hello, 7});
+
+	EXPECT_EQ(poll(&pfd, 1, 1'000), 1);
+	waiter.drainPollFd();
+	EXPECT_EQ(waiter.forEachNewSlot([](LockedView&& view) { EXPECT_EQ(view.span.len, 7); }), 1);
+
+	// Both writes were coalesced into one wakeup.
+	EXPECT_EQ(poll(&pfd, 1, 0), 0);
+
+	free(slot);
+	free(domain);
+}
+
+TEST(Dispatcher, SlowSlotDoesNotDelayOtherSlots) {
+	Domain* domain = malloc_domain();
+	Slot* image = malloc_slot();
+	Slot* imu = malloc_slot();
+	strcpy(image->name, "image");
+	strcpy(imu->name, "imu");
+	imu->index = 1;
+
+	std::atomic<int> imageInFlight = 0, maxImageInFlight = 0, nImage = 0, nImu = 0, nImuDuringImage = 0;
+	uint32_t lastImuSeq = 0;
+	bool imuInOrder = true;
+
+	Dispatcher dispatcher(domain, 2);
+	dispatcher.subscribeTo(image, [&](LockedView&& view) {
+		int n = ++imageInFlight;
+		maxImageInFlight = std::max(maxImageInFlight.load(), n);
+		usleep(20'000);
+		nImage++;
+		imageInFlight--;
+	});
+	dispatcher.subscribeTo(imu, [&](LockedView&& view) {
+		uint32_t seq = view.slot->seq.load();
+		if (seq <= lastImuSeq) imuInOrder = false;
+		lastImuSeq = seq;
+		if (imageInFlight.load() > 0) nImuDuringImage++;
+		nImu++;
+	});
+	dispatcher.start();
+
+	uint32_t v = 0;
+	for (int i = 0; i < 5; i++) {
+		image->write(domain, {&v, sizeof(v)});
+		for (int j = 0; j < 10; j++) {
+			usleep(2'000);
+			imu->write(domain, {&v, sizeof(v)});
+		}
+	}
+	usleep(50'000);
+	// Stopping must not bump the shared counter: that would wake other processes subscribed to the same bits.
+	uint32_t domainSeq = domain->seq.load();
+	dispatcher.stop();
+	EXPECT_EQ(domain->seq.load(), domainSeq);
+
+	EXPECT_GT(nImage.load(), 0);
+	EXPECT_EQ(maxImageInFlight.load(), 1);
+	EXPECT_GT(nImuDuringImage.load(), 0);
+	EXPECT_TRUE(imuInOrder);
+	EXPECT_EQ(dispatcher.stats().dispatched, nImage.load() + nImu.load());
+
+	free(imu);
+	free(image);
+	free(domain);
+}
+
 	
+TEST(Graph, LocalAndSharedEdges) {
+	// A previous run's "graphOut" would already hold the expected result.
+	for (const char* f : {"graphDom", "graphIn", "graphOut"}) unlink((std::string{Prefix} + f).c_str());
+	ClientDomain domain = ClientDomain::openOrCreate("graphDom");
+	ClientSlot& in = domain.getSlot("graphIn");
+	ClientSlot& out = domain.getSlot("graphOut");
+
+	// graphIn -> double -> (local) doubled -> plusOne -> graphOut
+	Graph graph(domain);
+	graph.addLocalEdge("doubled");
+	graph.addNode({"double", {"graphIn"}, {"doubled"}, [](NodeIo& io) {
+		uint32_t v;
+		memcpy(&v, io.input(0).ptr, sizeof(v));
+		ByteSpan o = io.output(0, sizeof(v));
+		*(uint32_t*)o.ptr = v * 2;
+		io.publish(0, sizeof(v));
+	}});
+	graph.addNode({"plusOne", {"doubled"}, {"graphOut"}, [](NodeIo& io) {
+		EXPECT_TRUE(io.isNew(0));
+		uint32_t v = *(const uint32_t*)io.input(0).ptr + 1;
+		io.write(0, {&v, sizeof(v)});
+	}});
+	uint32_t outSeq = out->seq.load();
+	graph.start();
+
+	for (uint32_t v = 1; v <= 10; v++) {
+		in.write({&v, sizeof(v)});
+		usleep(2'000);
+	}
+
+	uint32_t result = 0;
+	for (int i = 0; i < 100 and result != 21; i++) {
+		usleep(10'000);
+		auto view = out.read();
+		if (view.span.len == sizeof(result)) memcpy(&result, view.span.ptr, sizeof(result));
+	}
+	graph.stop();
+
+	EXPECT_EQ(result, 21);
+	EXPECT_GT(out->seq.load(), outSeq);
+	auto stats = graph.stats();
+	ASSERT_EQ(stats.size(), 2);
+	EXPECT_GT(stats[0].runs, 0);
+	EXPECT_GT(stats[1].runs, 0);
+	EXPECT_GE(stats[1].maxNanos, 0);
+
+	domain.removeSlot("graphIn");
+	domain.removeSlot("graphOut");
+	unlink((std::string{Prefix} + "graphDom").c_str());
+}
+
+TEST(Graph, LocalEdgesStayOutOfSharedMemory) {
+	for (const char* f : {"graphMixDom", "graphMixIn", "graphMixSide"}) unlink((std::string{Prefix} + f).c_str());
+	ClientDomain domain = ClientDomain::openOrCreate("graphMixDom");
+	ClientSlot& in = domain.getSlot("graphMixIn");
+	ClientSlot& side = domain.getSlot("graphMixSide");
+
+	// graphMixIn -> forward -> (local) tick -> mixed <- graphMixSide
+	std::atomic<int> nTicks { 0 }, nSide { 0 };
+	Graph graph(domain);
+	graph.addLocalEdge("tick");
+	graph.addNode({"forward", {"graphMixIn"}, {"tick"}, [](NodeIo& io) { io.write(0, io.input(0)); }});
+	graph.addNode({"mixed", {"tick", "graphMixSide"}, {}, [&](NodeIo& io) {
+		if (io.isNew(0)) nTicks++;
+		if (io.isNew(1)) nSide++;
+	}});
+	graph.start();
+
+	uint32_t v = 1;
+	uint32_t domainSeq = domain.ptr()->seq.load();
+	in.write({&v, sizeof(v)});
+	for (int i = 0; i < 100 and nTicks == 0; i++) usleep(1'000);
+	side.write({&v, sizeof(v)});
+	for (int i = 0; i < 100 and nSide == 0; i++) usleep(1'000);
+	graph.stop();
+
+	EXPECT_EQ(nTicks.load(), 1);
+	EXPECT_EQ(nSide.load(), 1);
+	// Only the two slot writes touched the shared counter: not the local edge, and not `stop()`.
+	EXPECT_EQ(domain.ptr()->seq.load(), domainSeq + 2);
+
+	domain.removeSlot("graphMixIn");
+	domain.removeSlot("graphMixSide");
+	unlink((std::string{Prefix} + "graphMixDom").c_str());
+}
+
+TEST(ClientDomain, ConcurrentCreatorsNeverSeeUninitializedFiles) {
+	// Many processes starting at once all race to create the same new domain and slot. Before files were
+	// published only once initialized, some of them failed the magic check.
+	constexpr int numProcs = 16, numRounds = 4;
+	for (int round = 0; round < numRounds; round++) {
+		unlink((std::string{Prefix} + "raceDom").c_str());
+		unlink((std::string{Prefix} + "raceSlot").c_str());
+
+		// Closing `go` releases all children at once.
+		int go[2];
+		ASSERT_EQ(pipe(go), 0);
+		std::vector<pid_t> pids;
+		for (int i = 0; i < numProcs; i++) {
+			pid_t pid = fork();
+			if (pid == 0) {
+				close(go[1]);
+				char c;
+				(void) !read(go[0], &c, 1);
+				try {
+					ClientDomain domain = ClientDomain::openOrCreate("raceDom");
+					ClientSlot& slot { domain.getSlot("raceSlot") };
+					_exit(strcmp(slot->name, "raceSlot") == 0 ? 0 : 2);
+				} catch (...) {
+					_exit(1);
+				}
+			}
+			pids.push_back(pid);
+		}
+		close(go[0]);
+		close(go[1]);
+
+		for (pid_t pid : pids) {
+			int wstat = 0;
+			waitpid(pid, &wstat, 0);
+			EXPECT_TRUE(WIFEXITED(wstat) and WEXITSTATUS(wstat) == 0) << "round " << round << " pid " << pid;
+		}
+	}
+	unlink((std::string{Prefix} + "raceDom").c_str());
+	unlink((std::string{Prefix} + "raceSlot").c_str());
+}
+
+TEST(ClientDomain, CreatorCrashingMidInitLeavesNoFiles) {
+	unlink((std::string{Prefix} + "crashDom").c_str());
+	pid_t pid = fork();
+	if (pid == 0) {
+		MmapBuilder builder;
+		builder.path(std::string{Prefix} + "crashDom").size(DomainFileSize).allowCreate();
+		builder.initializeWith([](void*) { _exit(0); });
+		builder.build();
+		_exit(1);
+	}
+	int wstat = 0;
+	waitpid(pid, &wstat, 0);
+	ASSERT_TRUE(WIFEXITED(wstat) and WEXITSTATUS(wstat) == 0);
+
+	// Neither the file nor a temporary one under another name.
+	DIR* dir = opendir(Prefix);
+	ASSERT_NE(dir, nullptr);
+	while (dirent* ent = readdir(dir)) EXPECT_EQ(strstr(ent->d_name, "crashDom"), nullptr) << ent->d_name;
+	closedir(dir);
+}
+
+TEST(ClientDomain, RemovesSlotsAndSweepsOrphans) {
+	auto exists = [](const char* name) { return access((std::string{Prefix} + name).c_str(), F_OK) == 0; };
+	uint64_t v = 1;
+
+	ClientDomain domain = ClientDomain::openOrCreate("lifeDom");
+	domain.getSlot("lifeA").write({&v, sizeof(v)});
+	ClientSlot& b = domain.getSlot("lifeB");
+	EXPECT_EQ(b->attachments().numAlive(), 1);
+
+	EXPECT_TRUE(domain.removeSlot("lifeA"));
+	EXPECT_FALSE(exists("lifeA"));
+	EXPECT_FALSE(domain.removeSlot("lifeA"));
+
+	// Attached by a process that died without detaching.
+	pid_t pid = fork();
+	if (pid == 0) {
+		ClientDomain child = ClientDomain::openOrCreate("lifeDom");
+		child.getSlot("lifeC");
+		_exit(0);
+	}
+	waitpid(pid, nullptr, 0);
+	// Attached and cleanly detached.
+	{
+		ClientDomain other = ClientDomain::openOrCreate("lifeDom");
+		other.getSlot("lifeD");
+	}
+	EXPECT_TRUE(exists("lifeC"));
+	EXPECT_TRUE(exists("lifeD"));
+
+	// Nothing has been idle for long enough.
+	EXPECT_EQ(domain.sweepOrphanSlots(), 0);
+
+	EXPECT_EQ(domain.sweepOrphanSlots(0), 2);
+	EXPECT_FALSE(exists("lifeC"));
+	EXPECT_FALSE(exists("lifeD"));
+	EXPECT_TRUE(exists("lifeB"));
+
+	// Removed slots come back empty when opened again.
+	EXPECT_EQ(domain.getSlot("lifeA").read().span.len, 0);
+
+	domain.removeSlot("lifeA");
+	domain.removeSlot("lifeB");
+	unlink((std::string{Prefix} + "lifeDom").c_str());
+}
+
+TEST(ClientDomain, RemovingAnAttachedSlotNeedsForceAndKeepsItsData) {
+	for (const char* f : {"keepDom", "keepSlot"}) unlink((std::string{Prefix} + f).c_str());
+	ClientDomain domain = ClientDomain::openOrCreate("keepDom");
+	ClientDomain other = ClientDomain::openOrCreate("keepDom");
+	ClientSlot& theirs = other.getSlot("keepSlot");
+	uint64_t v = 0x1234;
+	theirs.write({&v, sizeof(v)});
+
+	domain.getSlot("keepSlot");
+	EXPECT_FALSE(domain.removeSlot("keepSlot"));
+	EXPECT_EQ(access((std::string{Prefix} + "keepSlot").c_str(), F_OK), 0);
+
+	// Forced, the file goes but the attached reader still sees the data it had.
+	EXPECT_TRUE(domain.removeSlot("keepSlot", true));
+	EXPECT_NE(access((std::string{Prefix} + "keepSlot").c_str(), F_OK), 0);
+	auto view = theirs.read();
+	ASSERT_EQ(view.span.len, sizeof(v));
+	EXPECT_EQ(memcmp(view.span.ptr, &v, sizeof(v)), 0);
+
+	unlink((std::string{Prefix} + "keepDom").c_str());
+}
+
+TEST(ClientDomain, OpeningKeepsLastValueOfExitedProducer) {
+	for (const char* f : {"lastValueDom", "lastValueSlot"}) unlink((std::string{Prefix} + f).c_str());
+
+	// A producer writes once and exits long before anyone reads.
+	pid_t pid = fork();
+	if (pid == 0) {
+		ClientDomain domain = ClientDomain::openOrCreate("lastValueDom");
+		uint32_t v = 42;
+		domain.getSlot("lastValueSlot").write({&v, sizeof(v)});
+		domain.getSlot("lastValueSlot")->attachments().lastDetachNanos.store(0);
+		_exit(0);
+	}
+	waitpid(pid, nullptr, 0);
+
+	ClientDomain domain = ClientDomain::openOrCreate("lastValueDom");
+	ClientSlot* slot = domain.findSlot("lastValueSlot");
+	ASSERT_NE(slot, nullptr);
+	EXPECT_EQ(slot->read().span.len, sizeof(uint32_t));
+
+	domain.removeSlot("lastValueSlot");
+	unlink((std::string{Prefix} + "lastValueDom").c_str());
+}
+
+TEST(ClientSlot, AsyncPublisherIsMadeOnce) {
+	for (const char* f : {"asyncDom", "asyncSlot"}) unlink((std::string{Prefix} + f).c_str());
+	ClientDomain domain = ClientDomain::openOrCreate("asyncDom");
+	ClientSlot& slot = domain.getSlot("asyncSlot");
+
+	// Racing first uses all get the same publisher.
+	std::vector<AsyncPublisher*> seen(8);
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 8; i++) threads.emplace_back([&, i] { seen[i] = &slot.asyncPublisher(); });
+	for (auto& t : threads) t.join();
+	for (AsyncPublisher* p : seen) EXPECT_EQ(p, seen[0]);
+
+	EXPECT_EQ(slot.asyncPublisher(2).maxQueued(), 2);
+	EXPECT_THROW(slot.asyncPublisher(5), std::runtime_error);
+	EXPECT_TRUE(slot.writeAsync(std::vector<uint8_t>(10, 1)).get());
+
+	domain.removeSlot("asyncSlot");
+	unlink((std::string{Prefix} + "asyncDom").c_str());
+}
+
+TEST(ClientDomain, MoreSlotsThanTheRegistryHolds) {
+	constexpr int numSlots = MaxSlots + 6;
+	auto slotName = [](int i) { return "manySlots" + std::to_string(i); };
+	for (int i = 0; i < numSlots; i++) unlink((std::string{Prefix} + slotName(i)).c_str());
+	unlink((std::string{Prefix} + "manyDom").c_str());
+
+	ClientDomain domain = ClientDomain::openOrCreate("manyDom");
+	for (int i = 0; i < numSlots; i++) domain.getSlot(slotName(i).c_str());
+	EXPECT_EQ(domain.ptr()->numSlots, MaxSlots);
+
+	// The slots beyond the registry still deliver, on a shared futex bit.
+	ClientSlot& last = domain.getSlot(slotName(numSlots - 1).c_str());
+	EXPECT_EQ(last->index, UnregisteredSlotIndex);
+	std::atomic<bool> woke { false };
+	std::thread t([&]() {
+		Waiter waiter(domain.ptr());
+		waiter.subscribeTo(last.ptr());
+		while (waiter.forEachNewSlot([](LockedView&&) {}) == 0) waiter.waitExclusive();
+		woke = true;
+	});
+	usleep(10'000);
+	uint32_t v = 1;
+	last.write({&v, sizeof(v)});
+	t.join();
+	EXPECT_TRUE(woke);
+
+	for (int i = 0; i < numSlots; i++) domain.removeSlot(slotName(i).c_str());
+	unlink((std::string{Prefix} + "manyDom").c_str());
+}
+
+TEST(ClientDomain, RemovedSlotsFreeTheirRegistryEntry) {
+	constexpr int numSlots = 3 * MaxSlots;
+	auto slotName = [](int i) { return "churnSlot" + std::to_string(i); };
+	for (int i = 0; i < numSlots; i++) unlink((std::string{Prefix} + slotName(i)).c_str());
+	unlink((std::string{Prefix} + "churnDom").c_str());
+
+	ClientDomain domain = ClientDomain::openOrCreate("churnDom");
+	ClientSlot& kept = domain.getSlot("churnSlotKept");
+	for (int i = 0; i < numSlots; i++) {
+		ClientSlot& slot = domain.getSlot(slotName(i).c_str());
+		EXPECT_LT(slot->index, MaxSlots) << slotName(i);
+		if (i % 2 == 1) {
+			domain.removeSlot(slotName(i - 1).c_str());
+			domain.removeSlot(slotName(i).c_str());
+		}
+	}
+	EXPECT_EQ(kept->index, 0);
+	EXPECT_EQ(domain.ptr()->numSlots, 1);
+
+	domain.removeSlot("churnSlotKept");
+	EXPECT_EQ(domain.ptr()->numSlots, 0);
+	unlink((std::string{Prefix} + "churnDom").c_str());
+}
+
+TEST(ClientDomain, RejectsFilesOfAnotherLayout) {
+	for (const char* f : {"layoutDom", "layoutSlot"}) unlink((std::string{Prefix} + f).c_str());
+	{
+		ClientDomain domain = ClientDomain::openOrCreate("layoutDom");
+		domain.getSlot("layoutSlot")->layoutVersion = SlotLayoutVersion - 1;
+		EXPECT_THROW(ClientSlot::open(domain.ptr(), "layoutSlot"), std::runtime_error);
+		domain.ptr()->layoutVersion = DomainLayoutVersion - 1;
+	}
+	EXPECT_THROW(ClientDomain::open("layoutDom"), std::runtime_error);
+
+	unlink((std::string{Prefix} + "layoutDom").c_str());
+	unlink((std::string{Prefix} + "layoutSlot").c_str());
+}
+
+TEST(ClientDomain, SnapshotOfMissingSlotThrowsAndCreatesNothing) {
+	unlink((std::string{Prefix} + "snapMissing").c_str());
+	uint64_t v = 7;
+
+	ClientDomain domain = ClientDomain::openOrCreate("snapDom");
+	domain.getSlot("snapPresent").write({&v, sizeof(v)});
+
+	EXPECT_THROW(domain.readSnapshot({"snapPresent", "snapMissing"}), std::runtime_error);
+	EXPECT_NE(access((std::string{Prefix} + "snapMissing").c_str(), F_OK), 0);
+	EXPECT_EQ(domain.findSlot("snapMissing"), nullptr);
+
+	Snapshot snap = domain.readSnapshot({"snapPresent"});
+	ASSERT_EQ(snap.size(), 1);
+	EXPECT_EQ(snap[0].span.len, sizeof(v));
+
+	domain.removeSlot("snapPresent");
+	unlink((std::string{Prefix} + "snapDom").c_str());
+}
+
 TEST(Waiter, WaiterWorksAcrossTwoProcesses_SameTargetAddress) {
     spdlog::set_level(spdlog::level::trace);
 
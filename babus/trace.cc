@@ -0,0 +1,34 @@
+#include "trace.h"
+
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace babus {
+
+    namespace {
+        // Bumped in forked children, so threads there re-read their ids instead of reporting the parent's.
+        std::atomic<uint32_t> forkGeneration { 0 };
+
+        struct AtForkRegistration {
+            AtForkRegistration() {
+                pthread_atfork(nullptr, nullptr, []() { forkGeneration++; });
+            }
+        };
+        AtForkRegistration atForkRegistration;
+    }
+
+    const TraceThreadIds& traceThreadIds() {
+        static thread_local TraceThreadIds ids { 0, 0 };
+        static thread_local uint32_t generation = ~0u;
+
+        uint32_t cur = forkGeneration.load(std::memory_order_relaxed);
+        if (generation != cur) {
+            ids.pid    = getpid();
+            ids.tid    = syscall(SYS_gettid);
+            generation = cur;
+        }
+        return ids;
+    }
+
+}
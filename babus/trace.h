@@ -0,0 +1,103 @@
+#pragma once
+
+#include "babus/common.h"
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace babus {
+
+    //
+    // A per-domain event trace, kept in the domain file at `DomainTraceOffset`, so one ring holds the
+    // publish/lock/wake/dispatch timeline of every process attached to the domain.
+    //
+    // Appending costs one `fetch_add` on the ring head, a timestamp counter read and a 32-byte store, so it
+    // can stay on in production. It is switched on and off at runtime through `enabled` (see the
+    // `babusTrace` tool, which also dumps the ring as Chrome trace JSON for chrome://tracing or Perfetto).
+    // When disabled, a hook is one relaxed load.
+    //
+    // The ring overwrites its oldest records. Each record's `stamp` is written last, so a reader can
+    // tell a complete record of the lap it expects from one being overwritten.
+    //
+
+    enum class TraceEvent : uint8_t {
+        None      = 0,
+        WriteLock = 1, // Write lock acquired. `arg` is the number of ticks spent waiting for it.
+        Publish   = 2, // A write was published. `arg` is its length.
+        Wake      = 3, // `Waiter::waitExclusive` returned. `arg` is the wait mask.
+        Dispatch  = 4, // `Waiter::forEachNewSlot` handed a slot to its callback. `arg` is the number of skipped messages.
+    };
+
+    constexpr uint8_t TraceNoSlot = 0xff;
+
+    struct TraceRecord {
+        uint64_t ticks;
+        uint32_t arg;
+        int32_t pid;
+        int32_t tid;
+        uint32_t seq;
+        std::atomic<uint32_t> stamp; // Low 32 bits of (record index + 1) once the record is complete.
+        uint8_t slot;                // `Slot::index`, or `TraceNoSlot`.
+        TraceEvent event;
+        uint8_t pad[2];
+    };
+
+    static_assert(sizeof(TraceRecord) == 32, "TraceRecord should be 32 bytes");
+
+    // Timestamp counter on x86 (constant rate and synchronized across cores on anything recent), otherwise
+    // `CLOCK_MONOTONIC` nanoseconds. `babusTrace` converts ticks to time when dumping.
+    inline uint64_t traceTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return uint64_t(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+#endif
+    }
+
+    struct TraceThreadIds {
+        int32_t pid;
+        int32_t tid;
+    };
+    // Cached per thread (and refreshed in forked children): `getpid()`/`gettid()` are syscalls.
+    const TraceThreadIds& traceThreadIds();
+
+    struct TraceRing {
+        static constexpr uint64_t Capacity = TraceRingCapacity;
+
+        std::atomic<uint32_t> enabled;
+        uint32_t pad_;
+        std::atomic<uint64_t> head; // Total records ever appended.
+        uint8_t pad2_[48];
+        TraceRecord records[Capacity];
+
+        inline bool isEnabled() const {
+            return enabled.load(std::memory_order_relaxed) != 0;
+        }
+
+        inline void append(TraceEvent event, uint8_t slot, uint32_t seq, uint32_t arg) {
+            uint64_t i      = head.fetch_add(1, std::memory_order_relaxed);
+            TraceRecord& r  = records[i % Capacity];
+            const auto& ids = traceThreadIds();
+            r.stamp.store(0, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            r.ticks = traceTicks();
+            r.arg   = arg;
+            r.pid   = ids.pid;
+            r.tid   = ids.tid;
+            r.seq   = seq;
+            r.slot  = slot;
+            r.event = event;
+            r.stamp.store(uint32_t(i + 1), std::memory_order_release);
+        }
+    };
+
+    static_assert(DomainTraceOffset + sizeof(TraceRing) <= DomainFileSize, "TraceRing does not fit in the domain file");
+
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "client.h"
+
+#include <string_view>
+#include <type_traits>
+
+namespace babus {
+
+    //
+    // `TypedSlot<T>` carries one trivially copyable `T` per message. The size is a compile time constant, so writes and
+    // reads are fixed-size copies the compiler can inline, instead of a `memcpy` of a runtime `ByteSpan` length.
+    //
+    // The first typed attach records `typeHash<T>()` in the slot header. Attaching with another type throws, so
+    // processes built against different definitions of a message fail at startup instead of reading garbage. The hash
+    // covers the type's name, size and alignment. Define `static constexpr const char* babusTypeName` in `T` to keep it
+    // stable across compilers or renames. The byte API (`Slot::write`) is not checked.
+    //
+    //      struct Imu { double accel[3], gyro[3]; int64_t stampNanos; };
+    //      TypedSlot<Imu> imu { domain.getSlot("imu") };
+    //      imu.emplace(Imu { ... });
+    //      if (auto view = imu.read(); view.valid()) use(view->accel);
+    //
+
+    namespace detail {
+        constexpr uint64_t fnv1a(std::string_view s, uint64_t h = 0xcbf29ce484222325ull) {
+            for (char c : s) h = (h ^ uint8_t(c)) * 0x100000001b3ull;
+            return h;
+        }
+
+        template <class T, class = void> struct HasBabusTypeName : std::false_type { };
+        template <class T> struct HasBabusTypeName<T, std::void_t<decltype(T::babusTypeName)>> : std::true_type { };
+
+        template <class T> constexpr std::string_view typeName() {
+            if constexpr (HasBabusTypeName<T>::value)
+                return T::babusTypeName;
+            else
+                return __PRETTY_FUNCTION__; // Contains `T`'s name. Only stable across processes built by one compiler.
+        }
+    }
+
+    // Never zero: zero in `Slot::typeHash` means no type was recorded.
+    template <class T> constexpr uint64_t typeHash() {
+        uint64_t h = detail::fnv1a(detail::typeName<T>());
+        h          = (h ^ sizeof(T)) * 0x100000001b3ull;
+        h          = (h ^ alignof(T)) * 0x100000001b3ull;
+        return h == 0 ? 1 : h;
+    }
+
+    template <class T> struct TypedView {
+        LockedView view;
+
+        // False if the slot holds no `T`: never written, invalidated (see `LockedView::invalidated`), or last written
+        // through the byte API with another length.
+        inline bool valid() const {
+            return view.span.len == sizeof(T);
+        }
+        inline const T& operator*() const {
+            assert(valid());
+            return *reinterpret_cast<const T*>(view.span.ptr);
+        }
+        inline const T* operator->() const {
+            return &**this;
+        }
+        // Copy out, so the read lock can be released right away.
+        inline T copy() const {
+            T out;
+            memcpy(&out, view.span.ptr, sizeof(T));
+            return out;
+        }
+    };
+
+    template <class T> struct TypedSlot {
+        static_assert(std::is_trivially_copyable_v<T>, "TypedSlot<T> requires a trivially copyable T");
+        static_assert(sizeof(T) <= SlotDataCapacity, "T does not fit in a slot");
+        static_assert(alignof(T) <= SlotDataOffset, "The slot data is only page aligned");
+
+        static constexpr uint64_t Hash = typeHash<T>();
+
+        // Throws if the slot already holds another type.
+        inline TypedSlot(Slot* slot, Domain* dom)
+            : slot_(slot)
+            , dom_(dom) {
+            uint64_t expected = 0;
+            if (!slot->typeHash.compare_exchange_strong(expected, Hash) and expected != Hash) {
+                SPDLOG_ERROR("slot '{}' holds type {:#x} ({} bytes), not {:#x} ({} bytes, '{}')", slot->name, expected, slot->typeSize, Hash,
+                             sizeof(T), detail::typeName<T>());
+                throw std::runtime_error("slot type mismatch");
+            }
+            slot->typeSize = sizeof(T);
+        }
+        inline TypedSlot(ClientSlot& slot)
+            : TypedSlot(slot.ptr(), slot.domain()) {
+        }
+
+        inline void write(const T& v) {
+            auto wv = slot_->beginWrite(dom_);
+            memcpy(wv.span.ptr, &v, sizeof(T));
+            wv.commit(sizeof(T));
+        }
+
+        // Construct the message in place in shared memory, without a temporary.
+        template <class... Args> inline void emplace(Args&&... args) {
+            auto wv = slot_->beginWrite(dom_);
+            new (wv.span.ptr) T { std::forward<Args>(args)... };
+            wv.commit(sizeof(T));
+        }
+
+        inline TypedView<T> read() const {
+            return TypedView<T> { slot_->read() };
+        }
+
+        inline Slot* ptr() const {
+            return slot_;
+        }
+
+    private:
+        Slot* slot_;
+        Domain* dom_;
+    };
+
+}
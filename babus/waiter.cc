@@ -2,6 +2,15 @@
 
 namespace babus {
 
+    namespace {
+
+        void claimConsumerEntry(WaitTarget& tgt, const std::string& name) {
+            tgt.consumer_ = tgt.slot_->consumers().claim(name.c_str(), tgt.lastSeq_.load());
+            if (tgt.consumer_ == nullptr) SPDLOG_WARN("consumer table of slot '{}' is full, '{}' will not report its lag", tgt.slot_->name, name);
+        }
+
+    }
+
     WaitTarget::WaitTarget(Slot* slot, bool wakeWith)
         : slot_(slot)
         , wakeWith_(wakeWith) {
@@ -9,16 +18,30 @@ namespace babus {
     }
 
     WaitTarget::WaitTarget(WaitTarget&& o) {
-        slot_     = o.slot_;
-        lastSeq_  = o.lastSeq_.load();
-        wakeWith_ = o.wakeWith_;
+        slot_       = o.slot_;
+        lastSeq_    = o.lastSeq_.load();
+        wakeWith_   = o.wakeWith_;
+        latency_    = std::move(o.latency_);
+        delivered_  = o.delivered_;
+        skipped_    = o.skipped_;
+        consumer_   = o.consumer_;
+        o.consumer_ = nullptr;
     }
     WaitTarget& WaitTarget::operator=(WaitTarget&& o) {
-        slot_     = o.slot_;
-        lastSeq_  = o.lastSeq_.load();
-        wakeWith_ = o.wakeWith_;
+        ConsumerTable::release(consumer_);
+        slot_       = o.slot_;
+        lastSeq_    = o.lastSeq_.load();
+        wakeWith_   = o.wakeWith_;
+        latency_    = std::move(o.latency_);
+        delivered_  = o.delivered_;
+        skipped_    = o.skipped_;
+        consumer_   = o.consumer_;
+        o.consumer_ = nullptr;
         return *this;
     }
+    WaitTarget::~WaitTarget() {
+        ConsumerTable::release(consumer_);
+    }
 
     bool WaitTarget::checkAndUpdate() {
         auto newValue = slot_->seq.load();
@@ -30,23 +53,94 @@ namespace babus {
     }
 
     void Waiter::subscribeTo(Slot* slot, bool wakeWith) {
-        targets_.insert(slot->name, WaitTarget { slot, wakeWith });
+        WaitTarget tgt { slot, wakeWith };
+        if (trackLatency_) tgt.latency_ = std::make_unique<Log2Histogram>();
+        if (!consumerName_.empty()) claimConsumerEntry(tgt, consumerName_);
+        targets_.insert(slot->name, std::move(tgt));
+        if (poll_) poll_->setMask(waitMask());
     }
 
     void Waiter::unsubscribeFrom(Slot* slot) {
         targets_.erase(slot->name);
+        if (poll_) poll_->setMask(waitMask());
+    }
+
+    uint32_t Waiter::wakeMask() const {
+        uint32_t mask = 0;
+        for (const auto& kv : targets_)
+            if (kv.second.wakeWith_) mask |= kv.second.slot_->eventMask();
+        return mask;
+    }
+
+    uint32_t Waiter::waitMask() const {
+        if (uint32_t mask = wakeMask(); mask != 0) return mask;
+        // A zero bitset makes FUTEX_WAIT_BITSET fail with EINVAL, so wake with every target instead.
+        uint32_t mask = 0;
+        for (const auto& kv : targets_) mask |= kv.second.slot_->eventMask();
+        return mask;
+    }
+
+    bool Waiter::hasNewSlots() const {
+        for (const auto& kv : targets_)
+            if (kv.second.wakeWith_ and kv.second.slot_->seq.load() > kv.second.lastSeq_.load()) return true;
+        return false;
+    }
+
+    void Waiter::trackLatency() {
+        trackLatency_ = true;
+        for (auto& kv : targets_)
+            if (!kv.second.latency_) kv.second.latency_ = std::make_unique<Log2Histogram>();
+    }
+
+    const Log2Histogram* Waiter::latency(const Slot* slot) const {
+        for (const auto& kv : targets_)
+            if (kv.second.slot_ == slot) return kv.second.latency_.get();
+        return nullptr;
+    }
+
+    SubscriptionCounters Waiter::counters(const Slot* slot) const {
+        for (const auto& kv : targets_)
+            if (kv.second.slot_ == slot) return SubscriptionCounters { kv.second.delivered_, kv.second.skipped_ };
+        return {};
+    }
+
+    uint64_t Waiter::totalSkipped() const {
+        uint64_t n = 0;
+        for (const auto& kv : targets_) n += kv.second.skipped_;
+        return n;
+    }
+
+    void Waiter::registerConsumer(const char* name) {
+        consumerName_ = name;
+        for (auto& kv : targets_)
+            if (!kv.second.consumer_) claimConsumerEntry(kv.second, consumerName_);
+    }
+
+    int Waiter::pollFd() {
+        if (!poll_) poll_ = std::make_unique<PollRegistration>(domain, waitMask());
+        return poll_->fd();
+    }
+
+    void Waiter::drainPollFd() {
+        if (poll_) poll_->drain();
     }
 
     void Waiter::waitExclusive() {
         assert(targets_.size() > 0);
 
-        uint32_t mask = 0;
-        for (const auto& kv : targets_) mask |= (1u << kv.second.slot_->index);
+        uint32_t mask = waitMask();
 
         assert(domain != nullptr);
+        if constexpr (SlotStatsEnabled) {
+            for (auto& kv : targets_)
+                if (kv.second.wakeWith_) kv.second.slot_->stats().futexWaits.fetch_add(1, std::memory_order_relaxed);
+        }
+
         uint32_t prv = domain->seq.load();
         SPDLOG_TRACE("waitExclusive (global prv {}), waiting now on mask {}.", prv, mask);
         domain->seq.waitForChange(prv, mask);
+        domain->traceEvent(TraceEvent::Wake, TraceNoSlot, domain->seq.load(), mask);
+        BABUS_PROBE(waiter__wake, mask, domain->seq.load());
     }
 
 }
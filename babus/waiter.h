@@ -2,6 +2,11 @@
 
 #include "detail/small_map.hpp"
 #include "domain.h"
+#include "pollfd.h"
+
+#include <memory>
+#include <string>
+#include <type_traits>
 
 namespace babus {
 
@@ -16,11 +21,19 @@ namespace babus {
         Slot* slot_;
         std::atomic<uint32_t> lastSeq_;
         bool wakeWith_;
+        // Publish-to-dispatch latency of this subscription. Only allocated once `Waiter::trackLatency()`.
+        std::unique_ptr<Log2Histogram> latency_;
+        // Dispatched messages, and messages overwritten before they could be dispatched.
+        uint64_t delivered_ = 0;
+        uint64_t skipped_   = 0;
+        // This subscription's entry in the slot's `ConsumerTable`, after `Waiter::registerConsumer()`.
+        ConsumerEntry* consumer_ = nullptr;
 
         // The constructor will sample the sequence counter
         WaitTarget(Slot* slot, bool wakeWith);
         WaitTarget(WaitTarget&& o);
         WaitTarget& operator=(WaitTarget&& o);
+        ~WaitTarget();
 
         // Reload the sequence counter from the shared `Slot` atomic.
         // If it's higher than `lastSeq_` set `lastSeq_` to it and return true.
@@ -28,6 +41,11 @@ namespace babus {
         bool checkAndUpdate();
     };
 
+    struct SubscriptionCounters {
+        uint64_t delivered = 0;
+        uint64_t skipped   = 0; // Overwritten before this `Waiter` got to them.
+    };
+
     struct Waiter {
     public:
         inline Waiter(Domain* domain)
@@ -44,17 +62,69 @@ namespace babus {
         // Wait for the next event.
         void waitExclusive();
 
-        // Reload all sequence counters. For any that change, execute a user callable `f`.
+        // The union of the futex bits of all `wakeWith` targets.
+        uint32_t wakeMask() const;
+        // What `waitExclusive` and `pollFd()` wake on: `wakeMask()`, or the bits of all targets if none is `wakeWith`.
+        uint32_t waitMask() const;
+
+        // True if any `wakeWith` target was written since it was last visited. Updates nothing.
+        bool hasNewSlots() const;
+
+        // Keep a publish-to-dispatch latency histogram per subscription (current and future ones), measured
+        // from `Slot::publishNanos` to when `forEachNewSlot` has the read lock. Costs one clock read per dispatch.
+        void trackLatency();
+        // The histogram of `slot`, or null if latency is not tracked or `slot` is not subscribed.
+        const Log2Histogram* latency(const Slot* slot) const;
+
+        // Per-subscription delivered / skipped counts (zero if `slot` is not subscribed), and the skipped total.
+        SubscriptionCounters counters(const Slot* slot) const;
+        uint64_t totalSkipped() const;
+
+        // Publish this `Waiter`'s position in the `ConsumerTable` of every subscribed slot (current and future
+        // ones) under `name`, so publishers and `babusctl ls` can see its lag. A full table only logs a warning.
+        void registerConsumer(const char* name);
+
+        // Event-loop integration (see `pollfd.h`): a fd that becomes readable when a `wakeWith` target is written.
+        // Add it to epoll/poll/io_uring. When it is readable call `drainPollFd()`, then `forEachNewSlot()`.
+        // The fd is created on first use and owned by the `Waiter`.
+        int pollFd();
+        void drainPollFd();
+
+        // Reload all sequence counters. For any that change, execute a user callable `f`, either as
+        // `f(LockedView&&)` or as `f(LockedView&&, uint32_t skipped)`, where `skipped` is the number of messages
+        // of that slot that were overwritten since the last visit.
         // Return the number of targets that are new / were visited.
         template <class F> inline uint32_t forEachNewSlot(F&& f) {
             // waitExclusive();
             uint32_t n_updated = 0;
             for (auto& targetKv : targets_) {
                 WaitTarget& tgt  = targetKv.second;
+                uint32_t prvSeq  = tgt.lastSeq_.load();
                 bool tgt_updated = tgt.checkAndUpdate();
                 if (tgt_updated) {
                     n_updated++;
-                    f(tgt.slot_->read());
+                    LockedView view = tgt.slot_->read();
+                    // Writers bump `seq` under the write lock, so it is stable now and matches the data we see.
+                    uint32_t seq     = tgt.slot_->seq.load();
+                    uint32_t skipped = seq - prvSeq - 1;
+                    tgt.lastSeq_     = seq;
+                    tgt.delivered_++;
+                    tgt.skipped_ += skipped;
+                    domain->traceEvent(TraceEvent::Dispatch, tgt.slot_->index, seq, skipped);
+                    BABUS_PROBE(waiter__dispatch, tgt.slot_->name, seq);
+
+                    if (SlotStatsEnabled or tgt.latency_ or tgt.consumer_) {
+                        int64_t now     = monotonicNanos();
+                        int64_t latency = now - view.publishNanos;
+                        if constexpr (SlotStatsEnabled) tgt.slot_->stats().publishToReadNanos.record(latency);
+                        if (tgt.latency_) tgt.latency_->record(latency);
+                        if (tgt.consumer_) tgt.consumer_->record(seq, skipped, now);
+                    }
+
+                    if constexpr (std::is_invocable_v<F, LockedView&&, uint32_t>)
+                        f(std::move(view), skipped);
+                    else
+                        f(std::move(view));
                 }
             }
             return n_updated;
@@ -65,6 +135,11 @@ namespace babus {
 
         // NOTE: I don't think the char* is problematic assuming Domain lifetime includes this object's.
         SmallMap<const char*, WaitTarget> targets_;
+
+        std::unique_ptr<PollRegistration> poll_;
+
+        bool trackLatency_ = false;
+        std::string consumerName_; // Set by `registerConsumer()`.
     };
 
 }
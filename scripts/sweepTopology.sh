@@ -0,0 +1,58 @@
+#!/bin/sh
+#
+# Sweep reader fan-out and message size with `runProfileTopology`, one forked process per producer and
+# consumer. Run this from the build dir. Results go to `$out/fanout<F>_size<S>.csv/json` and are
+# concatenated into `$out/sweep.csv` with `fanout` and `size` columns prepended.
+#
+#   fanouts="1 4 16" sizes="128 65536" duration=5000 ../scripts/sweepTopology.sh
+#
+# Set `withRedis=1` to also run the single-process redis streams comparison (`runProfileRedis`).
+#
+set -e
+
+ninja
+
+export SPDLOG_LEVEL=${SPDLOG_LEVEL:-info}
+
+fanouts=${fanouts:-"1 2 4 8"}
+sizes=${sizes:-"64 4096 262144 6220800"}
+rate=${rate:-1000}
+duration=${duration:-10000} # ms
+mapping=${mapping:-distinct}
+out=${out:-sweep}
+
+mkdir -p "$out"
+rm -f "$out/sweep.csv"
+
+for fanout in $fanouts; do
+    for size in $sizes; do
+        name="fanout${fanout}_size${size}"
+        topo="$out/$name.topo"
+        cat > "$topo" <<TOPO
+domain   sweepDomain
+duration $duration
+mapping  $mapping
+slot     sweep size $size rate $rate
+producer sweep cpu 0
+consumer sweep count $fanout
+TOPO
+        printf '\n*** fan-out %s, message size %s ***\n' "$fanout" "$size"
+        rm -f /dev/shm/sweepDomain /dev/shm/sweep /dev/shm/topoControl
+        profileOut="$out/$name" ./runProfileTopology "$topo"
+
+        if [ ! -f "$out/sweep.csv" ]; then
+            head -n 1 "$out/$name.csv" | sed 's/^/fanout,size,/' > "$out/sweep.csv"
+        fi
+        tail -n +2 "$out/$name.csv" | sed "s/^/$fanout,$size,/" >> "$out/sweep.csv"
+    done
+done
+rm -f /dev/shm/sweepDomain /dev/shm/sweep /dev/shm/topoControl
+
+if [ "${withRedis:-0}" = "1" ]; then
+    for tcp in 1 0; do
+        printf '\n*** Redis (redisUseTcp=%s) ***\n' "$tcp"
+        redisUseTcp=$tcp testDuration=$((duration * 1000)) profileOut="$out/redis_tcp$tcp" ./babus/benchmark/profileRedis/runProfileRedis
+    done
+fi
+
+echo "wrote $out/sweep.csv"